@@ -44,6 +44,31 @@ namespace Port {
 
 class BackOff
 {
+public:
+	/// Scheduler queue operation scope.
+	/// 
+	/// The scheduler queue operations are not protected with Thread::PriorityBoost.
+	/// A thread spinning in such operation may wait for a preempted lower priority thread.
+	/// Inside the scope, a failed SwitchToThread () is followed by Sleep (0) when the contention persists.
+	/// Sleep (1) is not used because it stalls the scheduler for a whole timer tick (up to 15.6 ms).
+	class SchedulerOperation
+	{
+	public:
+		SchedulerOperation () noexcept :
+			prev_ (scheduler_operation_)
+		{
+			scheduler_operation_ = true;
+		}
+
+		~SchedulerOperation ()
+		{
+			scheduler_operation_ = prev_;
+		}
+
+	private:
+		bool prev_;
+	};
+
 protected:
 	/// A number of iterations when we should call yield ().
 	/// SwitchToThread () experiences the expensive cost of a context switch, which can be 10000+ cycles.
@@ -62,11 +87,20 @@ protected:
 
 	static void yield (unsigned iterations) noexcept
 	{
-		// If all concurrenting threads have the same priority, SwitchToThread will return TRUE.
-		// Otherwise the concurrency must be adjusted with Thread::PriorityBoost.
-		NIRVANA_VERIFY_EX (::SwitchToThread (), true);
+		if (scheduler_operation_) {
+			// SwitchToThread () yields to any thread ready on the current processor.
+			// If it fails, the thread we wait for may be preempted on another processor.
+			if (!::SwitchToThread () && iterations >= iterations_max ())
+				::Sleep (0);
+		} else {
+			// If all concurrenting threads have the same priority, SwitchToThread will return TRUE.
+			// Otherwise the concurrency must be adjusted with Thread::PriorityBoost.
+			NIRVANA_VERIFY_EX (::SwitchToThread (), true);
+		}
 	}
 
+private:
+	static thread_local bool scheduler_operation_;
 };
 
 }
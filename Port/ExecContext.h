@@ -34,18 +34,16 @@
 extern "C" __declspec (dllimport)
 void __stdcall DeleteFiber (void*);
 
-extern "C" __declspec (dllimport)
-void __stdcall SwitchToFiber (void* lpFiber);
-
-extern "C" __declspec (dllimport)
-void* __stdcall FlsGetValue (unsigned long dwFlsIndex);
-
 namespace Nirvana {
 namespace Core {
 
 class ExecContext;
 class ExecDomain;
 
+namespace Windows {
+class FiberPool;
+}
+
 namespace Port {
 
 /// Implements execution context
@@ -55,10 +53,7 @@ class ExecContext
 	/// Members called from Core.
 public:
 	/// \returns Current execution context.
-	static Core::ExecContext* current () noexcept
-	{
-		return (Core::ExecContext*)FlsGetValue (current_);
-	}
+	static Core::ExecContext* current () noexcept;
 
 	/// Constructor.
 	/// 
@@ -70,11 +65,7 @@ public:
 
 protected:
 	/// Switch to this context.
-	void switch_to () noexcept
-	{
-		assert (fiber_);
-		SwitchToFiber (fiber_);
-	}
+	void switch_to () noexcept;
 
 	///@}
 
@@ -109,18 +100,21 @@ public:
 
 private:
 	static void run (ExecDomain& ed) noexcept;
-	static void __stdcall fiber_proc (Core::ExecContext* context) noexcept;
+	static void __stdcall fiber_proc (void* pooled) noexcept;
 
 private:
-	static unsigned long current_;
+	static thread_local Core::ExecContext* current_;
 	static void* main_fiber_;
 	static std::atomic_flag main_fiber_allocated_;
 	static Core::ExecContext* main_fiber_context_;
+	static Windows::FiberPool fiber_pool_;
 #ifndef NDEBUG
 	static unsigned long dbg_main_thread_id_;
 #endif
 
 	void* fiber_;
+	void* pooled_; // FiberPool::Fiber
+	void* sp_; // Saved stack pointer for the user-mode context switch
 };
 
 }
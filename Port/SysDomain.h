@@ -46,8 +46,17 @@ public:
 	static IDL::String get_platform_dir (unsigned platform);
 
 protected:
+	/// Create the protection domain with the default core budget.
 	uint32_t create_prot_domain (unsigned platform, const IDL::String& host, unsigned port);
 
+	/// Create the protection domain.
+	/// 
+	/// \param core_quota Maximal number of cores the domain may use when other domains wait.
+	///   0 - unlimited.
+	/// \param core_weight Core share weight of the domain. 0 - no share limit.
+	uint32_t create_prot_domain (unsigned platform, const IDL::String& host, unsigned port,
+		unsigned core_quota, unsigned core_weight);
+
 	void on_domain_start (uint32_t id) noexcept
 	{
 		auto f = starting_map_.find (id);
@@ -38,12 +38,6 @@ void* __stdcall TlsGetValue (unsigned long dwTlsIndex);
 
 typedef void* HANDLE;
 
-extern "C" __declspec (dllimport)
-int __stdcall ImpersonateLoggedOnUser (HANDLE hToken);
-
-extern "C" __declspec (dllimport)
-int __stdcall RevertToSelf ();
-
 namespace Nirvana {
 namespace Core {
 
@@ -69,12 +63,8 @@ public:
 	}
 
 	/// Returns a pointer of the current execution context.
-	/// For Windows it is implemented via FlsGetValue().
-	/// If the system does not support fiber local storage,
-	/// then pointer to current context must be stored as
-	/// variable in Core::Thread class and updated for each
-	/// ExecContext::switch_to() call. So context() can be
-	/// implemented as Thread::current ().port ().context_.
+	/// For Windows it is implemented as a thread local variable
+	/// updated for each ExecContext::switch_to() call.
 	static Core::ExecContext* context () noexcept
 	{
 		return ExecContext::current ();
@@ -83,13 +73,11 @@ public:
 	/// Wait for the thread termination
 	void join () const noexcept;
 
-	static void impersonate (const Security::Context& sec_context) noexcept
-	{
-		if (sec_context.empty ())
-			NIRVANA_VERIFY (RevertToSelf ());
-		else
-			NIRVANA_VERIFY (ImpersonateLoggedOnUser (sec_context));
-	}
+	/// Impersonate the current thread.
+	/// 
+	/// The thread remembers the impersonated token. If the token of the new context
+	/// is the same, the impersonation is kept. An empty context reverts the impersonation.
+	static void impersonate (const Security::Context& sec_context) noexcept;
 
 	// Used to assign equal priority to all concurrenting threads
 	class PriorityBoost
@@ -123,14 +111,25 @@ public:
 	static bool initialize () noexcept;
 	static void terminate () noexcept;
 
+	/// Do not bind the thread to a processor.
+	static const unsigned ANY_PROCESSOR = ~0U;
+
+	/// Create thread.
+	/// 
+	/// \param priority Thread priority, THREAD_PRIORITY_NORMAL = 0.
+	/// \param processor Index of the logical processor in the system topology or ANY_PROCESSOR.
+	///   The thread is bound to the processor NUMA node and prefers the processor.
 	template <class T>
-	void create (T* p, int priority) // THREAD_PRIORITY_NORMAL = 0
+	void create (T* p, int priority, unsigned processor = ANY_PROCESSOR)
 	{
-		create ((PTHREAD_START_ROUTINE)T::thread_proc, p, priority);
+		create ((PTHREAD_START_ROUTINE)T::thread_proc, p, priority, processor);
 	}
 
 	static void current (Core::Thread* core_thread) noexcept;
 
+	/// Revert the impersonation of the current thread and forget the impersonated token.
+	static void revert () noexcept;
+
 	int priority () const noexcept;
 	void priority (int i) const noexcept;
 
@@ -142,12 +141,20 @@ protected:
 	~Thread ();
 
 private:
-	void create (PTHREAD_START_ROUTINE thread_proc, void* param, int priority);
+	void create (PTHREAD_START_ROUTINE thread_proc, void* param, int priority, unsigned processor);
 
 protected:
 	HANDLE handle_;
 
 	static unsigned long current_;
+	struct TokenId
+	{
+		uint64_t id;
+		uint64_t modified;
+	};
+
+	// The impersonated token of the system thread. Zero id if the thread is not impersonating.
+	static thread_local TokenId impersonated_;
 	static const int DEFAULT_PRIORITY_BOOST;
 };
 
@@ -29,13 +29,11 @@
 #pragma once
 
 #include <Thread.h>
+#include "../Source/AddressEvent.h"
 
 extern "C" __declspec (dllimport)
 int __stdcall SwitchToThread (void);
 
-extern "C" __declspec (dllimport)
-int __stdcall SetEvent (void* hEvent);
-
 namespace Nirvana {
 namespace Core {
 namespace Port {
@@ -79,11 +77,11 @@ private:
 
 	void resume () const noexcept
 	{
-		NIRVANA_VERIFY (SetEvent (event_));
+		event_.set ();
 	}
 
 private:
-	void* event_;
+	mutable Windows::AddressEvent event_;
 	volatile bool finish_;
 };
 
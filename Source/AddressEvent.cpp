@@ -0,0 +1,62 @@
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "AddressEvent.h"
+#include "win32.h"
+
+#pragma comment (lib, "Synchronization.lib")
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+void AddressEvent::wait (WorkerGate::SpinPolicy& policy) noexcept
+{
+	WorkerGate::Clock::time_point idle = WorkerGate::Clock::now ();
+	bool signaled = false;
+	uint32_t budget = policy.budget ();
+	if (budget) {
+		WorkerGate::Clock::time_point end = idle + std::chrono::nanoseconds (budget);
+		do {
+			for (unsigned i = 0; i < SPIN_CHECK; ++i) {
+				if ((signaled = try_reset ()))
+					break;
+				pause ();
+			}
+		} while (!signaled && WorkerGate::Clock::now () < end);
+	}
+	if (!signaled) {
+		while (!signal_.exchange (0, std::memory_order_acquire)) {
+			uint32_t zero = 0;
+			WaitOnAddress (&signal_, &zero, sizeof (zero), INFINITE);
+		}
+	}
+	policy.woken (std::chrono::duration_cast <std::chrono::nanoseconds> (
+		WorkerGate::Clock::now () - idle).count ());
+}
+
+}
+}
+}
@@ -0,0 +1,90 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_ADDRESSEVENT_H_
+#define NIRVANA_CORE_WINDOWS_ADDRESSEVENT_H_
+#pragma once
+
+#include "WorkerGate.h"
+
+extern "C" __declspec (dllimport)
+void __stdcall WakeByAddressSingle (void* Address);
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Auto-reset event on a memory word.
+/// 
+/// set () does not enter the kernel if no thread waits.
+/// wait () spins for a while before blocking in WaitOnAddress.
+class AddressEvent
+{
+	AddressEvent (const AddressEvent&) = delete;
+	AddressEvent& operator = (const AddressEvent&) = delete;
+
+public:
+	AddressEvent () noexcept :
+		signal_ (0)
+	{}
+
+	/// Set the event. If a thread waits, it is released.
+	void set () noexcept
+	{
+		if (!signal_.exchange (1, std::memory_order_release))
+			WakeByAddressSingle (&signal_);
+	}
+
+	/// Wait for the event and reset it.
+	/// 
+	/// \param policy Spin policy of the current thread.
+	void wait (WorkerGate::SpinPolicy& policy) noexcept;
+
+private:
+	bool try_reset () noexcept
+	{
+		return signal_.load (std::memory_order_relaxed) && signal_.exchange (0, std::memory_order_acquire);
+	}
+
+	static void pause () noexcept
+	{
+#if defined (_M_IX86) || defined (_M_X64) || defined (__i386__) || defined (__x86_64__)
+		_mm_pause ();
+#endif
+	}
+
+	/// Number of the signal checks between the clock reads.
+	static const unsigned SPIN_CHECK = 64;
+
+private:
+	std::atomic <uint32_t> signal_;
+};
+
+}
+}
+}
+
+#endif
@@ -31,6 +31,7 @@
 #include <StaticallyAllocated.h>
 #include "LockableHandle.h"
 #include "../Port/Memory.h"
+#include <atomic>
 
 typedef struct _MEMORY_BASIC_INFORMATION64 MEMORY_BASIC_INFORMATION64;
 
@@ -40,13 +41,93 @@ namespace Core {
 /// This namespace is not visible to the nirvana Core code.
 namespace Windows {
 
+/// Shadow of the page states of the mapped block.
+/// 
+/// The block page states are queried from the kernel only if the shadow is stale.
+/// Each change of the page states invalidates the shadow after the system call.
+/// The states that may change without our calls, like copy-on-write, are not stored.
+/// So the blocks with the copy-on-write pages are queried from the kernel each time.
+/// 
+/// It is assumed that the memory of the protection domain is changed by the Nirvana
+/// memory manager only. A VirtualProtect or VirtualFree call from another process
+/// does not invalidate the shadow and is not detected.
+/// 
+/// Each page state is stored as 3-bit code, see BlockState. The shadow is updated only if
+/// it was not invalidated since the query, this is checked by the generation counter.
+class PageStateShadow
+{
+public:
+	/// Pages per block
+	static const unsigned PAGES = 16;
+
+	/// Bits per page state code
+	static const unsigned CODE_BITS = 3;
+
+	typedef uint64_t Stamp;
+
+	void invalidate () noexcept
+	{
+		Stamp cur = val_.load (std::memory_order_relaxed);
+		while (!val_.compare_exchange_weak (cur,
+			((cur & GENERATION_MASK) + GENERATION_INC) & GENERATION_MASK,
+			std::memory_order_release, std::memory_order_relaxed))
+			;
+	}
+
+	/// Get the page state codes.
+	/// 
+	/// \param [out] stamp The stamp for update ().
+	/// \param [out] codes The page state codes.
+	/// 
+	/// \returns `false` if the shadow is stale.
+	bool get (Stamp& stamp, uint8_t codes [PAGES]) const noexcept
+	{
+		stamp = val_.load (std::memory_order_acquire);
+		if (!(stamp & VALID))
+			return false;
+		for (unsigned i = 0; i < PAGES; ++i) {
+			codes [i] = (uint8_t)((stamp >> (i * CODE_BITS)) & CODE_MASK);
+		}
+		return true;
+	}
+
+	/// Store the page state codes if the shadow was not invalidated after get ().
+	void update (Stamp stamp, const uint8_t codes [PAGES]) noexcept
+	{
+		assert (!(stamp & VALID));
+		Stamp val = (stamp & GENERATION_MASK) | VALID;
+		for (unsigned i = 0; i < PAGES; ++i) {
+			assert (codes [i] <= CODE_MASK);
+			val |= (Stamp)codes [i] << (i * CODE_BITS);
+		}
+		val_.compare_exchange_strong (stamp, val, std::memory_order_release, std::memory_order_relaxed);
+	}
+
+private:
+	static const Stamp CODE_MASK = (1 << CODE_BITS) - 1;
+	static const Stamp VALID = (Stamp)1 << 63;
+	static const Stamp GENERATION_INC = (Stamp)1 << (PAGES * CODE_BITS);
+	static const Stamp GENERATION_MASK = ~VALID & ~(GENERATION_INC - 1);
+
+	std::atomic <Stamp> val_;
+};
+
 /// Memory block (64K) information.
+/// The directory is shared between processes, so the structure has the same layout
+/// in 32 and 64-bit code. It is zero-initialized.
 struct BlockInfo
 {
-	// Currently we are using only one field. But we create structure for possible future extensions.
 	LockableHandle mapping;
+
+	/// The memory section may be mapped to other blocks or processes.
+	/// Set on the handle duplication, cleared when the block gets a new section.
+	std::atomic <bool> shared;
+
+	alignas (8) PageStateShadow page_states;
 };
 
+static_assert (sizeof (BlockInfo) == 16, "BlockInfo size must be power of 2");
+
 /// Logical address space of some Windows process.
 template <bool x64>
 class AddressSpace
@@ -133,17 +214,42 @@ public:
 		/// Unmap the block
 		void unmap ();
 
+		/// \returns `false` if the memory section is private for sure.
+		bool may_be_shared () const noexcept
+		{
+			return info_.shared.load (std::memory_order_acquire);
+		}
+
+		/// Mark the memory section as shared.
+		void set_shared () noexcept
+		{
+			info_.shared.store (true, std::memory_order_release);
+		}
+
 	protected:
 		friend class Port::Memory;
 
+		/// Called after the page state change.
 		void invalidate_state ()
 		{
 			state_ = State::PAGE_STATE_UNKNOWN;
+			info_.page_states.invalidate ();
+		}
+
+		PageStateShadow& page_states () const
+		{
+			return info_.page_states;
 		}
 
 		void map (HANDLE mapping_map, HANDLE mapping_store);
 
-		void map_copy (HANDLE src_mapping);
+		void map_copy (Port::Memory::Block& src);
+
+		void reset_shared () noexcept
+		{
+			assert (exclusive_);
+			info_.shared.store (false, std::memory_order_relaxed);
+		}
 
 		void protect (size_t offset, size_t size, uint32_t protection);
 
@@ -197,6 +303,18 @@ private:
 
 	BlockInfo* block_ptr (Address address, bool commit);
 
+	/// Bit of the directory64_ page in the committed_ bitmap.
+	static const size_t BITMAP_WORD_BITS = sizeof (size_t) * 8;
+
+	bool directory_committed (size_t page) const noexcept
+	{
+		return (committed_ [page / BITMAP_WORD_BITS].load (std::memory_order_acquire)
+			& ((size_t)1 << (page % BITMAP_WORD_BITS))) != 0;
+	}
+
+	size_t directory_pages () const noexcept;
+	bool commit_directory (BlockInfo** pp) noexcept;
+
 	static Address address (void* addr) noexcept
 	{
 		return (Address)(uint64_t)addr;
@@ -217,6 +335,9 @@ private:
 		BlockInfo** directory64_;
 		void* directory_;
 	};
+	// Bitmap of the committed directory64_ pages.
+	// Lets the lookup check the page presence without VirtualQuery.
+	std::atomic <size_t>* committed_;
 	static const uint32_t SECOND_LEVEL_BLOCK = Port::Memory::ALLOCATION_UNIT / sizeof (BlockInfo);
 };
 
@@ -146,6 +146,7 @@ void AddressSpace <x64>::Block::protect (size_t offset, size_t size, uint32_t pr
 		unsigned long old;
 		NIRVANA_VERIFY (VirtualProtectEx (space_.process (), (void*)(uintptr_t)addr, size, protection, &old));
 	}
+	info_.page_states.invalidate ();
 }
 
 template <bool x64> inline
@@ -259,7 +260,8 @@ bool AddressSpace <x64>::Block::exclusive_lock ()
 		exclusive_ = true;
 		if (!mapping_)
 			throw_INTERNAL (); // The block was unexpectedly released in another thread.
-		invalidate_state ();
+		// The state could be changed by other threads. They invalidated the shadow.
+		state_ = State::PAGE_STATE_UNKNOWN;
 		return true;
 	}
 	return false;
@@ -313,6 +315,8 @@ void AddressSpace <x64>::Block::map (HANDLE mapping_map, HANDLE mapping_store)
 
 	if (!space_.map (mapping_map, address (), ALLOCATION_GRANULARITY, MEM_REPLACE_PLACEHOLDER))
 		throw_NO_MEMORY ();
+	info_.page_states.invalidate ();
+	reset_shared ();
 }
 
 template <bool x64>
@@ -324,6 +328,8 @@ void AddressSpace <x64>::Block::unmap ()
 	if (INVALID_HANDLE_VALUE != hm) {
 		NIRVANA_VERIFY (space_.unmap (address (), MEM_PRESERVE_PLACEHOLDER));
 		state_ = State::RESERVED;
+		info_.page_states.invalidate ();
+		reset_shared ();
 		space_.close_mapping (hm);
 		mapping (INVALID_HANDLE_VALUE);
 	}
@@ -336,7 +342,7 @@ void AddressSpace <x64>::Block::copy (Port::Memory::Block& src, size_t offset, s
 	assert (size);
 	assert (offset + size <= ALLOCATION_GRANULARITY);
 
-	map_copy (src.mapping ());
+	map_copy (src);
 
 	// Fix access to the pages.
 	size_t start_page = offset / PAGE_SIZE;
@@ -391,8 +397,11 @@ void AddressSpace <x64>::Block::copy (Port::Memory::Block& src, size_t offset, s
 }
 
 template <bool x64>
-void AddressSpace <x64>::Block::map_copy (HANDLE src_mapping)
+void AddressSpace <x64>::Block::map_copy (Port::Memory::Block& src)
 {
+	HANDLE src_mapping = src.mapping ();
+	// Mark the source before the duplication, so a concurrent check can't miss the new handle.
+	src.set_shared ();
 	HANDLE hm;
 	if (!DuplicateHandle (GetCurrentProcess (), src_mapping, space_.process (), &hm, 0, FALSE, DUPLICATE_SAME_ACCESS))
 		throw_NO_MEMORY ();
@@ -402,6 +411,7 @@ void AddressSpace <x64>::Block::map_copy (HANDLE src_mapping)
 		space_.close_mapping (hm);
 		throw;
 	}
+	set_shared ();
 }
 
 template <bool x64> inline
@@ -409,7 +419,8 @@ AddressSpace <x64>::AddressSpace () noexcept :
 	process_ (nullptr),
 	file_ (INVALID_HANDLE_VALUE),
 	mapping_ (nullptr),
-	directory_ (nullptr)
+	directory_ (nullptr),
+	committed_ (nullptr)
 {}
 
 template <bool x64> inline
@@ -493,11 +504,20 @@ bool AddressSpace <x64>::initialize (uint32_t process_id, HANDLE process_handle)
 		return false;
 	}
 
-	if (x64)
+	if (x64) {
 		directory64_ = (BlockInfo**)VirtualAlloc (nullptr,
 			(size_t)(directory_size_ + SECOND_LEVEL_BLOCK - 1) / SECOND_LEVEL_BLOCK * sizeof (BlockInfo*),
 			MEM_RESERVE, PAGE_READWRITE);
-	else
+		if (directory64_) {
+			committed_ = (std::atomic <size_t>*)VirtualAlloc (nullptr,
+				(directory_pages () + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS * sizeof (size_t),
+				MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (!committed_) {
+				VirtualFree (directory64_, 0, MEM_RELEASE);
+				directory64_ = nullptr;
+			}
+		}
+	} else
 		directory32_ = (BlockInfo*)MapViewOfFile (mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0);
 
 	if (!directory_) {
@@ -518,15 +538,14 @@ AddressSpace <x64>::~AddressSpace () noexcept
 		if (x64) {
 			BlockInfo** end = directory64_ + (directory_size_ + SECOND_LEVEL_BLOCK - 1) / SECOND_LEVEL_BLOCK;
 			for (BlockInfo** page = directory64_; page < end; page += PAGE_SIZE / sizeof (BlockInfo**)) {
-				MEMORY_BASIC_INFORMATION mbi;
-				NIRVANA_VERIFY (VirtualQuery (page, &mbi, sizeof (mbi)));
-				if (mbi.State == MEM_COMMIT) {
+				if (directory_committed ((page - directory64_) * sizeof (BlockInfo*) / PAGE_SIZE)) {
 					BlockInfo** end = page + PAGE_SIZE / sizeof (BlockInfo**);
 					for (BlockInfo** p = page; p < end; ++p) {
 						BlockInfo* block = *p;
 						if (block) {
 #ifndef NDEBUG
 							if (GetCurrentProcess () == process_) {
+								MEMORY_BASIC_INFORMATION mbi;
 								BYTE* address = (BYTE*)((p - directory64_) * SECOND_LEVEL_BLOCK * ALLOCATION_GRANULARITY);
 								for (BlockInfo* page = block, *end = block + SECOND_LEVEL_BLOCK; page != end; page += PAGE_SIZE / sizeof (BlockInfo)) {
 									NIRVANA_VERIFY (VirtualQuery (page, &mbi, sizeof (mbi)));
@@ -553,6 +572,7 @@ AddressSpace <x64>::~AddressSpace () noexcept
 				}
 			}
 			NIRVANA_VERIFY (VirtualFree (directory64_, 0, MEM_RELEASE));
+			NIRVANA_VERIFY (VirtualFree (committed_, 0, MEM_RELEASE));
 		} else {
 #ifndef NDEBUG
 			if (GetCurrentProcess () == process_) {
@@ -595,14 +615,11 @@ BlockInfo* AddressSpace <x64>::block_ptr (Address address, bool commit)
 			Size i1 = idx % SECOND_LEVEL_BLOCK;
 
 			BlockInfo** pp = directory64_ + i0;
-			if (commit) {
-				if (!VirtualAlloc (pp, sizeof (BlockInfo*), MEM_COMMIT, PAGE_READWRITE))
-					throw_NO_MEMORY ();
-			} else {
-				MEMORY_BASIC_INFORMATION mbi;
-				NIRVANA_VERIFY (VirtualQuery (pp, &mbi, sizeof (mbi)));
-				if (mbi.State != MEM_COMMIT)
+			if (!directory_committed ((size_t)i0 * sizeof (BlockInfo*) / PAGE_SIZE)) {
+				if (!commit)
 					return nullptr;
+				if (!commit_directory (pp))
+					throw_NO_MEMORY ();
 			}
 			p = *pp;
 			if (!p && commit) {
@@ -628,6 +645,25 @@ BlockInfo* AddressSpace <x64>::block_ptr (Address address, bool commit)
 	return p;
 }
 
+template <bool x64> inline
+size_t AddressSpace <x64>::directory_pages () const noexcept
+{
+	return ((size_t)(directory_size_ + SECOND_LEVEL_BLOCK - 1) / SECOND_LEVEL_BLOCK * sizeof (BlockInfo*)
+		+ PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+template <bool x64>
+bool AddressSpace <x64>::commit_directory (BlockInfo** pp) noexcept
+{
+	// Commit is idempotent, so the concurrent threads may commit the same page without a lock.
+	// The bit is set after the commit, so the page is accessible when the bit is visible.
+	size_t page = (pp - directory64_) * sizeof (BlockInfo*) / PAGE_SIZE;
+	if (!VirtualAlloc (directory64_ + page * PAGE_SIZE / sizeof (BlockInfo*), PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE))
+		return false;
+	committed_ [page / BITMAP_WORD_BITS].fetch_or ((size_t)1 << (page % BITMAP_WORD_BITS), std::memory_order_release);
+	return true;
+}
+
 template <bool x64>
 typename AddressSpace <x64>::Address AddressSpace <x64>::reserve (Address dst, size_t& size, unsigned flags)
 {
@@ -666,6 +702,8 @@ typename AddressSpace <x64>::Address AddressSpace <x64>::reserve (Address dst, s
 				BlockInfo& bi = block (pb);
 				bi.mapping.exclusive_lock ();
 				assert (!bi.mapping);
+				bi.page_states.invalidate ();
+				bi.shared.store (false, std::memory_order_relaxed);
 				bi.mapping.init_invalid ();
 			}
 		} catch (...) { // NO_MEMORY for directory allocation
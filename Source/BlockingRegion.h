@@ -0,0 +1,70 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_BLOCKINGREGION_H_
+#define NIRVANA_CORE_WINDOWS_BLOCKINGREGION_H_
+#pragma once
+
+#include "SchedulerBase.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Surrounds a synchronous system call that may block for a long time.
+/// 
+/// While a worker thread is blocked, its core is returned to the scheduler
+/// and a spare worker thread may use it. See BLOCKING_SPARE_WORKERS_MAX.
+/// At the end of the region the thread waits until the scheduler grants a core again.
+/// Regions may be nested. In other threads the region does nothing.
+class BlockingRegion
+{
+	BlockingRegion (const BlockingRegion&) = delete;
+	BlockingRegion& operator = (const BlockingRegion&) = delete;
+
+public:
+	BlockingRegion () noexcept :
+		scheduler_ (SchedulerBase::get ())
+	{
+		if (scheduler_)
+			scheduler_->blocking_begin ();
+	}
+
+	~BlockingRegion ()
+	{
+		if (scheduler_)
+			scheduler_->blocking_end ();
+	}
+
+private:
+	SchedulerBase* scheduler_;
+};
+
+}
+}
+}
+
+#endif
@@ -24,6 +24,7 @@
 *  popov.nirvana@gmail.com
 */
 #include "BufferPool.h"
+#include "SystemTopology.h"
 #include <Heap.h>
 
 namespace Nirvana {
@@ -33,17 +34,46 @@ namespace Windows {
 BufferPool::BufferPool (size_t buffer_count, size_t buffer_size) noexcept :
 	begin_ (nullptr),
 	end_ (nullptr),
-	buffer_size_ (round_up (buffer_size, sizeof (LONG_PTR)))
+	buffer_size_ (round_up (buffer_size, sizeof (LONG_PTR))),
+	numa_ (false)
 {
 	size_t size = buffer_count * (sizeof (OVERLAPPED) + buffer_size_);
-	size_t cb = size;
-	begin_ = (OVERLAPPED*)Heap::shared_heap ().allocate (nullptr, cb, 0);
+	const Topology& topology = SystemTopology::topology ();
+	unsigned nodes = topology.node_count ();
+	if (nodes > 1 && size >= nodes * PAGE_SIZE) {
+		// Reserve the contiguous range and commit equal parts on each node.
+		BYTE* p = (BYTE*)VirtualAlloc (nullptr, size, MEM_RESERVE, PAGE_READWRITE);
+		if (p) {
+			HANDLE process = GetCurrentProcess ();
+			size_t commit_size = round_up (size, PAGE_SIZE);
+			size_t part = round_down (commit_size / nodes, PAGE_SIZE);
+			bool ok = true;
+			for (unsigned node = 0; node < nodes && ok; ++node) {
+				size_t offset = part * node;
+				size_t cb = node == nodes - 1 ? commit_size - offset : part;
+				ok = VirtualAllocExNuma (process, p + offset, cb, MEM_COMMIT, PAGE_READWRITE,
+					topology.node_number (node)) != nullptr;
+			}
+			if (ok) {
+				begin_ = (OVERLAPPED*)p;
+				numa_ = true;
+			} else
+				VirtualFree (p, 0, MEM_RELEASE);
+		}
+	}
+	if (!begin_) {
+		size_t cb = size;
+		begin_ = (OVERLAPPED*)Heap::shared_heap ().allocate (nullptr, cb, 0);
+	}
 	end_ = (OVERLAPPED*)(((BYTE*)begin_) + size);
 }
 
 BufferPool::~BufferPool () noexcept
 {
-	Heap::shared_heap ().release (begin_, (BYTE*)end_ - (BYTE*)begin_);
+	if (numa_)
+		VirtualFree (begin_, 0, MEM_RELEASE);
+	else
+		Heap::shared_heap ().release (begin_, (BYTE*)end_ - (BYTE*)begin_);
 }
 
 }
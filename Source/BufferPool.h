@@ -44,6 +44,7 @@ private:
 	BufferPool& operator = (const BufferPool&) = delete;
 
 public:
+	/// If the system has several NUMA nodes, buffers are spread over the nodes.
 	BufferPool (size_t buffer_count, size_t buffer_size) noexcept;
 	~BufferPool () noexcept;
 
@@ -77,6 +78,7 @@ private:
 	OVERLAPPED* begin_;
 	OVERLAPPED* end_;
 	size_t buffer_size_;
+	bool numa_; // Memory is spread over the NUMA nodes with VirtualAllocExNuma
 };
 
 }
@@ -26,6 +26,9 @@
 #include "CompletionPort.h"
 #include "CompletionPortReceiver.h"
 #include "error2errno.h"
+#include <winternl.h>
+
+#pragma comment (lib, "ntdll.lib")
 
 namespace Nirvana {
 namespace Core {
@@ -44,7 +47,39 @@ void CompletionPort::create (HANDLE hfile, CompletionPortReceiver* receiver)
 	completion_port_ = port;
 }
 
-void CompletionPort::thread_proc ()
+bool CompletionPort::thread_proc (unsigned batch, DWORD timeout)
+{
+	if (batch <= 1)
+		return thread_proc_single (timeout);
+	if (batch > BATCH_MAX)
+		batch = BATCH_MAX;
+
+	OVERLAPPED_ENTRY entries [BATCH_MAX];
+	for (;;) {
+		HANDLE cp = completion_port_;
+		if (!cp)
+			break;
+		ULONG count;
+		if (!GetQueuedCompletionStatusEx (cp, entries, batch, &count, timeout, FALSE)) {
+			DWORD error = GetLastError ();
+			if (WAIT_TIMEOUT == error)
+				return true;
+			assert (ERROR_ABANDONED_WAIT_0 == error);
+			break;
+		}
+		for (const OVERLAPPED_ENTRY* entry = entries, *end = entries + count; entry != end; ++entry) {
+			// Internal contains the packet status. It is 0 for the posted packets.
+			DWORD error = 0;
+			if (entry->Internal)
+				error = RtlNtStatusToDosError ((NTSTATUS)entry->Internal);
+			reinterpret_cast <CompletionPortReceiver*> (entry->lpCompletionKey)->completed (
+				entry->lpOverlapped, entry->dwNumberOfBytesTransferred, error);
+		}
+	}
+	return false;
+}
+
+bool CompletionPort::thread_proc_single (DWORD timeout)
 {
 	for (;;) {
 		ULONG_PTR key;
@@ -53,20 +88,21 @@ void CompletionPort::thread_proc ()
 		HANDLE cp = completion_port_;
 		if (!cp)
 			break;
-		BOOL ok = GetQueuedCompletionStatus (cp, &size, &key, &ovl, INFINITE);
+		BOOL ok = GetQueuedCompletionStatus (cp, &size, &key, &ovl, timeout);
 		if (ovl) {
 			DWORD error = 0;
 			if (!ok)
 				error = GetLastError ();
 			reinterpret_cast <CompletionPortReceiver*> (key)->completed (ovl, size, error);
 		} else {
-#ifndef NDEBUG
 			DWORD error = GetLastError ();
+			if (WAIT_TIMEOUT == error)
+				return true;
 			assert (ERROR_ABANDONED_WAIT_0 == error);
-#endif
 			break;
 		}
 	}
+	return false;
 }
 
 }
@@ -45,6 +45,9 @@ private:
 	CompletionPort& operator = (const CompletionPort&) = delete;
 
 public:
+	/// Maximal number of packets dequeued by one call.
+	static const unsigned BATCH_MAX = 16;
+
 	static unsigned int thread_count ()
 	{
 		return Port::SystemInfo::hardware_concurrency ();
@@ -80,7 +83,13 @@ public:
 	}
 
 	/// Worker thread procedure.
-	void thread_proc ();
+	/// 
+	/// \param batch Maximal number of packets dequeued by one call.
+	///   Packets of the batch are processed sequentially by the calling thread,
+	///   so the batch must be 1 if the packet processing is long.
+	/// \param timeout Idle time in milliseconds after which the procedure returns.
+	/// \returns `true` if the timeout expired, `false` if the port was closed.
+	bool thread_proc (unsigned batch = BATCH_MAX, DWORD timeout = INFINITE);
 
 protected:
 	/// Ensure that port exists.
@@ -92,6 +101,7 @@ protected:
 
 private:
 	void create (HANDLE hfile, CompletionPortReceiver* receiver);
+	bool thread_proc_single (DWORD timeout);
 
 private:
 	HANDLE completion_port_;
@@ -0,0 +1,317 @@
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "ContextSwitch.h"
+
+#ifdef NIRVANA_CONTEXT_SWITCH
+
+extern "C" void nirvana_context_start ();
+
+// The context switch procedures.
+// nirvana_context_start is the first "return address" of a new context.
+// It calls entry (param) with the values restored from the initial frame.
+
+#if defined (__x86_64__) && defined (_WIN32)
+
+// Windows x64. Frame layout from the saved stack pointer:
+// FP control, XMM6-XMM15, TEB StackBase, StackLimit, DeallocationStack,
+// R15, R14, R13, R12, RSI, RDI, RBX, RBP, return address.
+__asm__ (R"(
+	.text
+	.def nirvana_context_swap; .scl 2; .type 32; .endef
+	.globl nirvana_context_swap
+	.p2align 4
+nirvana_context_swap:
+	pushq %rbp
+	pushq %rbx
+	pushq %rdi
+	pushq %rsi
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	pushq %gs:0x1478
+	pushq %gs:0x10
+	pushq %gs:0x8
+	subq $168, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movaps %xmm6, 8(%rsp)
+	movaps %xmm7, 24(%rsp)
+	movaps %xmm8, 40(%rsp)
+	movaps %xmm9, 56(%rsp)
+	movaps %xmm10, 72(%rsp)
+	movaps %xmm11, 88(%rsp)
+	movaps %xmm12, 104(%rsp)
+	movaps %xmm13, 120(%rsp)
+	movaps %xmm14, 136(%rsp)
+	movaps %xmm15, 152(%rsp)
+	movq %rsp, (%rcx)
+	movq %rdx, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	movaps 8(%rsp), %xmm6
+	movaps 24(%rsp), %xmm7
+	movaps 40(%rsp), %xmm8
+	movaps 56(%rsp), %xmm9
+	movaps 72(%rsp), %xmm10
+	movaps 88(%rsp), %xmm11
+	movaps 104(%rsp), %xmm12
+	movaps 120(%rsp), %xmm13
+	movaps 136(%rsp), %xmm14
+	movaps 152(%rsp), %xmm15
+	addq $168, %rsp
+	popq %gs:0x8
+	popq %gs:0x10
+	popq %gs:0x1478
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rsi
+	popq %rdi
+	popq %rbx
+	popq %rbp
+	retq
+
+	.def nirvana_context_start; .scl 2; .type 32; .endef
+	.globl nirvana_context_start
+	.p2align 4
+nirvana_context_start:
+	.seh_proc nirvana_context_start
+	subq $48, %rsp
+	.seh_stackalloc 48
+	.seh_endprologue
+	movq %r12, %rcx
+	callq *%rbx
+	ud2
+	.seh_endproc
+)");
+
+static const size_t FRAME_SLOTS = 33;
+static const size_t SLOT_R12 = 27;
+static const size_t SLOT_RBX = 30;
+static const uint64_t FP_CONTROL = 0x027Full << 32 | 0x1F80;
+
+#elif defined (__x86_64__)
+
+// System V x86-64. Frame layout from the saved stack pointer:
+// FP control, R15, R14, R13, R12, RBX, RBP, return address.
+__asm__ (R"(
+	.text
+	.globl nirvana_context_swap
+	.type nirvana_context_swap, @function
+	.p2align 4
+nirvana_context_swap:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	retq
+	.size nirvana_context_swap, .-nirvana_context_swap
+
+	.globl nirvana_context_start
+	.type nirvana_context_start, @function
+	.p2align 4
+nirvana_context_start:
+	.cfi_startproc
+	.cfi_undefined rip
+	movq %r12, %rdi
+	callq *%rbx
+	ud2
+	.cfi_endproc
+	.size nirvana_context_start, .-nirvana_context_start
+)");
+
+static const size_t FRAME_SLOTS = 8;
+static const size_t SLOT_R12 = 4;
+static const size_t SLOT_RBX = 5;
+static const uint64_t FP_CONTROL = 0x037Full << 32 | 0x1F80;
+
+#elif defined (__aarch64__)
+
+// ARM64. Frame layout from the saved stack pointer:
+// X19-X28, FP, LR, D8-D15, FPCR, TEB StackBase, StackLimit, DeallocationStack (Windows only).
+
+#ifdef _WIN32
+#define CONTEXT_SWAP_SAVE_TEB "\
+	ldr x9, [x18, #8]\n\
+	ldr x10, [x18, #16]\n\
+	stp x9, x10, [sp, #168]\n\
+	ldr x9, [x18, #0x1478]\n\
+	str x9, [sp, #184]\n"
+#define CONTEXT_SWAP_LOAD_TEB "\
+	ldp x9, x10, [sp, #168]\n\
+	str x9, [x18, #8]\n\
+	str x10, [x18, #16]\n\
+	ldr x9, [sp, #184]\n\
+	str x9, [x18, #0x1478]\n"
+#define CONTEXT_PROC(name) "\
+	.def " #name "; .scl 2; .type 32; .endef\n\
+	.globl " #name "\n\
+	.p2align 4\n"
+#define CONTEXT_PROC_END(name)
+// The zero frame pointer and return address saved by the prologue stop the unwinding.
+#define CONTEXT_START_BEGIN "\
+	.seh_proc nirvana_context_start\n\
+	stp xzr, xzr, [sp, #-16]!\n\
+	.seh_save_fplr_x 16\n\
+	.seh_endprologue\n"
+#define CONTEXT_START_END "	.seh_endproc\n"
+#else
+#define CONTEXT_SWAP_SAVE_TEB
+#define CONTEXT_SWAP_LOAD_TEB
+#define CONTEXT_PROC(name) "\
+	.globl " #name "\n\
+	.type " #name ", %function\n\
+	.p2align 4\n"
+#define CONTEXT_PROC_END(name) "\
+	.size " #name ", .-" #name "\n"
+#define CONTEXT_START_BEGIN "\
+	.cfi_startproc\n\
+	.cfi_undefined x30\n"
+#define CONTEXT_START_END "	.cfi_endproc\n"
+#endif
+
+__asm__ (
+	"	.text\n"
+	CONTEXT_PROC (nirvana_context_swap)
+"nirvana_context_swap:\n\
+	sub sp, sp, #192\n\
+	stp x19, x20, [sp, #0]\n\
+	stp x21, x22, [sp, #16]\n\
+	stp x23, x24, [sp, #32]\n\
+	stp x25, x26, [sp, #48]\n\
+	stp x27, x28, [sp, #64]\n\
+	stp x29, x30, [sp, #80]\n\
+	stp d8, d9, [sp, #96]\n\
+	stp d10, d11, [sp, #112]\n\
+	stp d12, d13, [sp, #128]\n\
+	stp d14, d15, [sp, #144]\n\
+	mrs x9, fpcr\n\
+	str x9, [sp, #160]\n"
+	CONTEXT_SWAP_SAVE_TEB
+"	mov x9, sp\n\
+	str x9, [x0]\n\
+	mov sp, x1\n"
+	CONTEXT_SWAP_LOAD_TEB
+"	ldr x9, [sp, #160]\n\
+	msr fpcr, x9\n\
+	ldp x19, x20, [sp, #0]\n\
+	ldp x21, x22, [sp, #16]\n\
+	ldp x23, x24, [sp, #32]\n\
+	ldp x25, x26, [sp, #48]\n\
+	ldp x27, x28, [sp, #64]\n\
+	ldp x29, x30, [sp, #80]\n\
+	ldp d8, d9, [sp, #96]\n\
+	ldp d10, d11, [sp, #112]\n\
+	ldp d12, d13, [sp, #128]\n\
+	ldp d14, d15, [sp, #144]\n\
+	add sp, sp, #192\n\
+	ret\n"
+	CONTEXT_PROC_END (nirvana_context_swap)
+	CONTEXT_PROC (nirvana_context_start)
+"nirvana_context_start:\n"
+	CONTEXT_START_BEGIN
+"	mov x0, x20\n\
+	blr x19\n\
+	brk #0\n"
+	CONTEXT_START_END
+	CONTEXT_PROC_END (nirvana_context_start)
+);
+
+static const size_t FRAME_SLOTS = 24;
+static const size_t SLOT_ENTRY = 0;  // X19
+static const size_t SLOT_PARAM = 1;  // X20
+static const size_t SLOT_LR = 11;
+
+#endif
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+void* ContextSwitch::make (const Stack& stack, Entry entry, void* param) noexcept
+{
+	uintptr_t top = (uintptr_t)stack.base & ~(uintptr_t)15;
+
+#if defined (__x86_64__)
+#ifdef _WIN32
+	// The zero return address above the start procedure frame stops the unwinding.
+	top -= 16;
+	*(uint64_t*)top = 0;
+#endif
+	uint64_t* frame = (uint64_t*)top - FRAME_SLOTS;
+	for (size_t i = 0; i < FRAME_SLOTS; ++i) {
+		frame [i] = 0;
+	}
+	frame [0] = FP_CONTROL;
+	frame [SLOT_R12] = (uint64_t)param;
+	frame [SLOT_RBX] = (uint64_t)entry;
+	frame [FRAME_SLOTS - 1] = (uint64_t)&nirvana_context_start;
+#ifdef _WIN32
+	frame [21] = (uint64_t)stack.base;
+	frame [22] = (uint64_t)stack.limit;
+	frame [23] = (uint64_t)stack.deallocation;
+#endif
+#else
+	uint64_t* frame = (uint64_t*)top - FRAME_SLOTS;
+	for (size_t i = 0; i < FRAME_SLOTS; ++i) {
+		frame [i] = 0;
+	}
+	frame [SLOT_ENTRY] = (uint64_t)entry;
+	frame [SLOT_PARAM] = (uint64_t)param;
+	frame [SLOT_LR] = (uint64_t)&nirvana_context_start;
+#ifdef _WIN32
+	frame [21] = (uint64_t)stack.base;
+	frame [22] = (uint64_t)stack.limit;
+	frame [23] = (uint64_t)stack.deallocation;
+#endif
+#endif
+
+	return frame;
+}
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,92 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_CONTEXTSWITCH_H_
+#define NIRVANA_CORE_WINDOWS_CONTEXTSWITCH_H_
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// Defined if ContextSwitch is implemented for the target platform.
+#if defined (__x86_64__) || defined (__aarch64__)
+#define NIRVANA_CONTEXT_SWITCH
+#endif
+
+extern "C" void nirvana_context_swap (void** from, void* to);
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// User-mode context switch.
+/// 
+/// Saves the callee-saved registers and the floating point control state on the current stack,
+/// stores the stack pointer and loads the other one.
+/// On Windows it also switches the stack bounds in the TEB, so the stack growth,
+/// the structured exception dispatching and the unwinding work as with fibers.
+/// The fiber local storage is not switched.
+/// 
+/// Implemented for x86-64 (Windows and System V ABI) and ARM64.
+/// Does not depend on Windows API.
+/// The CET shadow stack is not switched, so the class must not be used when it is enabled.
+class ContextSwitch
+{
+public:
+	/// Context entry procedure. Must never return.
+	typedef void (*Entry) (void* param);
+
+	/// Stack bounds.
+	struct Stack
+	{
+		void* base;         ///< Top of the stack (highest address).
+		void* limit;        ///< Lowest committed address.
+		void* deallocation; ///< Start of the stack reservation.
+	};
+
+	/// Build the initial frame for a new context.
+	/// 
+	/// \param stack The stack.
+	/// \param entry The entry procedure.
+	/// \param param The entry procedure parameter.
+	/// \returns The saved stack pointer of the new context.
+	static void* make (const Stack& stack, Entry entry, void* param) noexcept;
+
+	/// Switch the context.
+	/// 
+	/// \param [out] from Receives the saved stack pointer of the current context.
+	/// \param to The saved stack pointer of the target context.
+	static void swap (void** from, void* to) noexcept
+	{
+		nirvana_context_swap (from, to);
+	}
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,116 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_COREBUDGET_H_
+#define NIRVANA_CORE_WINDOWS_COREBUDGET_H_
+#pragma once
+
+#include <atomic>
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Core budget of a protection domain.
+/// 
+/// The master grants a core to the domain with the earliest deadline. If the domain already
+/// uses its limit of cores, the grant is not made and the domain item is requeued with a delayed
+/// deadline. When the requeued item is extracted and the domain is still over the limit,
+/// it is granted only if no items of other domains wait, so the domain borrows the idle capacity only.
+/// Otherwise the item is requeued again with the larger delay.
+/// 
+/// The limit is the minimum of the quota and the weighted share of the cores
+/// among the domains with nonzero weight.
+/// 
+/// The class does not depend on Windows API and can be tested on any host.
+class CoreBudget
+{
+public:
+	CoreBudget () noexcept :
+		quota_ (0),
+		weight_ (0)
+	{}
+
+	/// Set the budget.
+	/// 
+	/// \param quota Maximal number of cores. 0 - unlimited.
+	/// \param weight Share weight. 0 - no share limit.
+	void set (unsigned quota, unsigned weight) noexcept
+	{
+		quota_.store (quota, std::memory_order_relaxed);
+		weight_.store (weight, std::memory_order_relaxed);
+	}
+
+	unsigned quota () const noexcept
+	{
+		return quota_.load (std::memory_order_relaxed);
+	}
+
+	unsigned weight () const noexcept
+	{
+		return weight_.load (std::memory_order_relaxed);
+	}
+
+	/// \param cores Total number of cores.
+	/// \param total_weight Sum of the weights of all domains.
+	/// \returns Maximal number of cores the domain may use under contention. 0 - unlimited.
+	unsigned limit (unsigned cores, unsigned total_weight) const noexcept
+	{
+		unsigned limit = quota ();
+		unsigned w = weight ();
+		if (w && total_weight) {
+			unsigned share = (unsigned)((uint64_t)cores * w / total_weight);
+			if (!share)
+				share = 1;
+			if (!limit || limit > share)
+				limit = share;
+		}
+		return limit;
+	}
+
+	/// Check the grant.
+	/// 
+	/// \param used Number of cores used by the domain.
+	/// \param cores Total number of cores.
+	/// \param total_weight Sum of the weights of all domains.
+	/// \returns `true` if the core may be granted.
+	///   `false` if the domain item must be requeued with the delayed deadline.
+	bool admit (unsigned used, unsigned cores, unsigned total_weight) const noexcept
+	{
+		unsigned l = limit (cores, total_weight);
+		return !l || used < l;
+	}
+
+private:
+	std::atomic <unsigned> quota_;
+	std::atomic <unsigned> weight_;
+};
+
+}
+}
+}
+
+#endif
@@ -24,6 +24,7 @@
 *  popov.nirvana@gmail.com
 */
 #include "DirIterator.h"
+#include "BlockingRegion.h"
 #include "error2errno.h"
 #include <Nirvana/string_conv.h>
 
@@ -36,7 +37,10 @@ namespace Windows {
 DirIterator::DirIterator (const WinWChar* pattern) :
 	handle_ (INVALID_HANDLE_VALUE)
 {
-	handle_ = FindFirstFileExW (pattern, FindExInfoBasic, &data_, FindExSearchNameMatch, nullptr, 0);
+	{
+		BlockingRegion blocking;
+		handle_ = FindFirstFileExW (pattern, FindExInfoBasic, &data_, FindExSearchNameMatch, nullptr, 0);
+	}
 	if (INVALID_HANDLE_VALUE == handle_) {
 		// We can not throw user exception by the specification.
 		throw_win_error_sys (GetLastError ());
@@ -49,7 +53,12 @@ DirIterator::DirIterator (const WinWChar* pattern) :
 
 bool DirIterator::move_next () noexcept
 {
-	if (!FindNextFileW (handle_, &data_)) {
+	BOOL found;
+	{
+		BlockingRegion blocking;
+		found = FindNextFileW (handle_, &data_);
+	}
+	if (!found) {
 		FindClose (handle_);
 		handle_ = INVALID_HANDLE_VALUE;
 		return false;
@@ -24,6 +24,8 @@
 *  popov.nirvana@gmail.com
 */
 #include "ExecContext.inl"
+#include "FiberPool.h"
+#include "ContextSwitch.h"
 #include <ExecDomain.h>
 #include <Thread.h>
 #include <unrecoverable_error.h>
@@ -33,39 +35,81 @@ namespace Nirvana {
 namespace Core {
 namespace Port {
 
-unsigned long ExecContext::current_;
+thread_local Core::ExecContext* ExecContext::current_;
 void* ExecContext::main_fiber_;
 std::atomic_flag ExecContext::main_fiber_allocated_ = ATOMIC_FLAG_INIT;
 Core::ExecContext* ExecContext::main_fiber_context_;
+Windows::FiberPool ExecContext::fiber_pool_ ((LPFIBER_START_ROUTINE)fiber_proc);
 
 #ifndef NDEBUG
 unsigned long ExecContext::dbg_main_thread_id_;
 #endif
 
+// The current context accessors are not inline.
+// Fibers migrate between threads and the compiler may cache the thread local
+// variable address across the context switch in the inlined code.
+
+Core::ExecContext* ExecContext::current () noexcept
+{
+	return current_;
+}
+
+void ExecContext::current (Core::ExecContext* context) noexcept
+{
+	current_ = context;
+}
+
+void ExecContext::switch_to () noexcept
+{
+	Core::ExecContext* from = current_;
+	current_ = static_cast <Core::ExecContext*> (this);
+	if (fiber_pool_.user_mode_context_switch ()) {
+		assert (from && sp_);
+		Windows::ContextSwitch::swap (&static_cast <ExecContext&> (*from).sp_, sp_);
+	} else {
+		assert (fiber_);
+		SwitchToFiber (fiber_);
+	}
+}
+
 ExecContext::ExecContext (bool neutral) :
-	fiber_ (nullptr)
+	fiber_ (nullptr),
+	pooled_ (nullptr),
+	sp_ (nullptr)
 {
 	if (!neutral) {
 		Core::ExecContext* core_context = static_cast <Core::ExecContext*> (this);
-		if (!main_fiber_allocated_.test_and_set ()) {
+		// With the user-mode context switch, the main fiber is used by the neutral context only.
+		if (!fiber_pool_.user_mode_context_switch () && !main_fiber_allocated_.test_and_set ()) {
 			main_fiber_context_ = core_context;
 			fiber_ = main_fiber_;
 		} else {
-			fiber_ = CreateFiberEx (0, 0, FIBER_FLAG_FLOAT_SWITCH, (LPFIBER_START_ROUTINE)fiber_proc, core_context);
-			if (!fiber_)
-				throw CORBA::NO_MEMORY ();
+			Windows::FiberPool::Fiber* fiber = fiber_pool_.acquire (core_context);
+			pooled_ = fiber;
+			if (fiber_pool_.user_mode_context_switch ())
+				sp_ = fiber->handle;
+			else
+				fiber_ = fiber->handle;
 		}
 	}
 }
 
 ExecContext::~ExecContext ()
 {
-	if (fiber_) {
+	if (fiber_pool_.user_mode_context_switch () && pooled_) {
+		assert (this != current_);
+		Windows::FiberPool::Fiber* fiber = (Windows::FiberPool::Fiber*)pooled_;
+		fiber->handle = sp_;
+		fiber_pool_.release (fiber);
+	} else if (fiber_) {
 		if (fiber_ == main_fiber_)
 			main_fiber_allocated_.clear ();
 		else {
 			assert (fiber_ != GetCurrentFiber ());
-			DeleteFiber (fiber_);
+			if (pooled_)
+				fiber_pool_.release ((Windows::FiberPool::Fiber*)pooled_);
+			else
+				DeleteFiber (fiber_);
 		}
 	}
 }
@@ -75,12 +119,16 @@ inline void ExecContext::run (ExecDomain& ed) noexcept
 	ed.run ();
 }
 
-void __stdcall ExecContext::fiber_proc (Core::ExecContext* context) noexcept
+void __stdcall ExecContext::fiber_proc (void* pooled) noexcept
 {
-	assert (context);
-	current (context);
+	Windows::FiberPool::Fiber* fiber = (Windows::FiberPool::Fiber*)pooled;
 	for (;;) {
+		// The pooled fiber may be resumed here by another context after reuse.
+		Core::ExecContext* context = (Core::ExecContext*)fiber->param;
+		assert (context);
+		current (context);
 		run (ExecDomain::current ());
+		Windows::FiberPool::trim_stack ();
 	}
 	// Fiber procedures never complete.
 }
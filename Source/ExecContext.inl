@@ -29,7 +29,7 @@
 #pragma once
 
 #include "../Port/ExecContext.h"
-#include "win32.h"
+#include "FiberPool.h"
 
 namespace Nirvana {
 namespace Core {
@@ -41,8 +41,6 @@ bool ExecContext::initialize () noexcept
 #ifndef NDEBUG
 	dbg_main_thread_id_ = GetCurrentThreadId ();
 #endif
-	if (FLS_OUT_OF_INDEXES == (current_ = FlsAlloc (nullptr)))
-		return false;
 	main_fiber_ = ConvertThreadToFiberEx (nullptr, FIBER_FLAG_FLOAT_SWITCH);
 	return main_fiber_ != nullptr;
 }
@@ -51,14 +49,8 @@ inline
 void ExecContext::terminate () noexcept
 {
 	assert (dbg_main_thread_id_ == GetCurrentThreadId ());
+	fiber_pool_.clear ();
 	ConvertFiberToThread ();
-	FlsFree (current_);
-}
-
-inline
-void ExecContext::current (Core::ExecContext* context) noexcept
-{
-	FlsSetValue (current_, context);
 }
 
 inline
@@ -0,0 +1,197 @@
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "FiberPool.h"
+#include "ContextSwitch.h"
+#include "../Port/config.h"
+#include <Nirvana/Nirvana.h>
+#include <intrin.h>
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+#ifndef NIRVANA_CONTEXT_SWITCH
+static_assert (!USER_MODE_CONTEXT_SWITCH, "ContextSwitch is not implemented for the target platform.");
+#endif
+
+static const ULONGLONG SHRINK_PERIOD_MS = OBJECT_POOL_SHRINK_PERIOD / TimeBase::MILLISECOND;
+
+FiberPool::FiberPool (LPFIBER_START_ROUTINE proc) noexcept :
+	user_mode_context_switch_ (USER_MODE_CONTEXT_SWITCH && !user_shadow_stack ()),
+	proc_ (proc),
+	free_ (nullptr),
+	free_cnt_ (0),
+	min_free_cnt_ (0),
+	shrink_time_ (0)
+{
+	InitializeSRWLock (&lock_);
+}
+
+FiberPool::Fiber* FiberPool::acquire (void* param)
+{
+	Fiber* fiber = nullptr;
+	Fiber* garbage = nullptr;
+	AcquireSRWLockExclusive (&lock_);
+	if ((fiber = free_)) {
+		free_ = fiber->next;
+		if (min_free_cnt_ > --free_cnt_)
+			min_free_cnt_ = free_cnt_;
+	}
+	shrink (garbage);
+	ReleaseSRWLockExclusive (&lock_);
+	delete_list (garbage);
+
+	if (!fiber) {
+		fiber = new Fiber;
+		create (*fiber);
+		if (!fiber->handle) {
+			delete fiber;
+			throw CORBA::NO_MEMORY ();
+		}
+	}
+	fiber->param = param;
+	fiber->next = nullptr;
+	return fiber;
+}
+
+void FiberPool::release (Fiber* fiber) noexcept
+{
+	assert (fiber && fiber->handle != GetCurrentFiber ());
+	fiber->param = nullptr;
+	Fiber* garbage = nullptr;
+	AcquireSRWLockExclusive (&lock_);
+	fiber->next = free_;
+	free_ = fiber;
+	++free_cnt_;
+	shrink (garbage);
+	ReleaseSRWLockExclusive (&lock_);
+	delete_list (garbage);
+}
+
+void FiberPool::clear () noexcept
+{
+	AcquireSRWLockExclusive (&lock_);
+	Fiber* garbage = free_;
+	free_ = nullptr;
+	free_cnt_ = min_free_cnt_ = 0;
+	ReleaseSRWLockExclusive (&lock_);
+	delete_list (garbage);
+}
+
+void FiberPool::create (Fiber& fiber) noexcept
+{
+	fiber.handle = nullptr;
+	fiber.stack = nullptr;
+	if (!user_mode_context_switch ()) {
+		fiber.handle = CreateFiberEx (FIBER_STACK_COMMIT, 0, FIBER_FLAG_FLOAT_SWITCH, proc_, &fiber);
+		return;
+	}
+
+	// Reserve the stack, commit the head and the guard page below it, like CreateFiberEx does.
+	uint8_t* stack = (uint8_t*)VirtualAlloc (nullptr, FIBER_STACK_RESERVE, MEM_RESERVE, PAGE_READWRITE);
+	if (!stack)
+		return;
+	uint8_t* base = stack + FIBER_STACK_RESERVE;
+	uint8_t* limit = base - FIBER_STACK_COMMIT;
+	if (!VirtualAlloc (limit, FIBER_STACK_COMMIT, MEM_COMMIT, PAGE_READWRITE)
+		|| !VirtualAlloc (limit - PAGE_SIZE, PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE | PAGE_GUARD)) {
+		VirtualFree (stack, 0, MEM_RELEASE);
+		return;
+	}
+	fiber.stack = stack;
+	ContextSwitch::Stack bounds = { base, limit, stack };
+	fiber.handle = ContextSwitch::make (bounds, (ContextSwitch::Entry)proc_, &fiber);
+}
+
+bool FiberPool::user_shadow_stack () noexcept
+{
+#if defined (__x86_64__)
+	PROCESS_MITIGATION_USER_SHADOW_STACK_POLICY policy;
+	return GetProcessMitigationPolicy (GetCurrentProcess (), ProcessUserShadowStackPolicy, &policy, sizeof (policy))
+		&& policy.EnableUserShadowStack;
+#else
+	return false;
+#endif
+}
+
+void FiberPool::shrink (Fiber*& garbage) noexcept
+{
+	ULONGLONG now = GetTickCount64 ();
+	if (now < shrink_time_)
+		return;
+
+	// Fibers that stayed free during the whole period are not needed.
+	if (shrink_time_ && min_free_cnt_ > FIBER_POOL_MIN) {
+		for (unsigned cnt = min_free_cnt_ - FIBER_POOL_MIN; cnt; --cnt) {
+			Fiber* fiber = free_;
+			free_ = fiber->next;
+			fiber->next = garbage;
+			garbage = fiber;
+			--free_cnt_;
+		}
+	}
+	min_free_cnt_ = free_cnt_;
+	shrink_time_ = now + SHRINK_PERIOD_MS;
+}
+
+void FiberPool::delete_list (Fiber* list) noexcept
+{
+	while (list) {
+		Fiber* next = list->next;
+		if (list->stack)
+			VirtualFree (list->stack, 0, MEM_RELEASE);
+		else
+			DeleteFiber (list->handle);
+		delete list;
+		list = next;
+	}
+}
+
+void FiberPool::trim_stack () noexcept
+{
+	NT_TIB* tib = (NT_TIB*)NtCurrentTeb ();
+	uint8_t* limit = (uint8_t*)tib->StackLimit;
+	if ((size_t)((uint8_t*)tib->StackBase - limit) <= FIBER_STACK_TRIM)
+		return;
+
+	// All stack below the current frame is unused.
+	uint8_t* sp = (uint8_t*)_AddressOfReturnAddress ();
+	uint8_t* new_limit = (uint8_t*)((uintptr_t)sp & ~(uintptr_t)(PAGE_SIZE - 1)) - FIBER_STACK_COMMIT;
+	if (new_limit <= limit + PAGE_SIZE)
+		return;
+
+	// Move the guard page up, then decommit the pages below it.
+	uint8_t* guard = new_limit - PAGE_SIZE;
+	tib->StackLimit = new_limit;
+	DWORD old;
+	NIRVANA_VERIFY (VirtualProtect (guard, PAGE_SIZE, PAGE_READWRITE | PAGE_GUARD, &old));
+	uint8_t* old_guard = limit - PAGE_SIZE;
+	NIRVANA_VERIFY (VirtualFree (old_guard, guard - old_guard, MEM_DECOMMIT));
+}
+
+}
+}
+}
@@ -0,0 +1,125 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_FIBERPOOL_H_
+#define NIRVANA_CORE_WINDOWS_FIBERPOOL_H_
+#pragma once
+
+#include "win32.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Process-wide pool of the ready fibers.
+/// 
+/// Creation of a fiber maps and commits the whole fiber stack and deletion frees it.
+/// The pool keeps released fibers for reuse.
+/// The fiber procedure must not complete. It gets the Fiber record as parameter
+/// and must read Fiber::param again each time it is resumed after the reuse.
+/// 
+/// The pool keeps at least FIBER_POOL_MIN free fibers.
+/// Fibers that were not used during the OBJECT_POOL_SHRINK_PERIOD are deleted.
+class FiberPool
+{
+	FiberPool (const FiberPool&) = delete;
+	FiberPool& operator = (const FiberPool&) = delete;
+
+public:
+	/// Pooled fiber record.
+	/// 
+	/// With the user-mode context switch, `handle` is the saved stack pointer
+	/// of the ContextSwitch context and `stack` is the stack reservation.
+	struct Fiber
+	{
+		void* handle;
+		void* stack;
+		void* param;
+		Fiber* next;
+	};
+
+	/// Constructor.
+	/// 
+	/// \param proc The fiber procedure. Receives Fiber* as parameter.
+	FiberPool (LPFIBER_START_ROUTINE proc) noexcept;
+
+	~FiberPool ()
+	{
+		clear ();
+	}
+
+	/// Get a fiber from the pool or create a new one.
+	/// 
+	/// \param param Fiber parameter.
+	/// \returns Fiber record.
+	/// \throws CORBA::NO_MEMORY
+	Fiber* acquire (void* param);
+
+	/// Return the fiber to the pool.
+	/// The fiber must not be current.
+	/// 
+	/// \param fiber Fiber record.
+	void release (Fiber* fiber) noexcept;
+
+	/// Delete all free fibers.
+	void clear () noexcept;
+
+	/// \returns `true` if the contexts are switched with ContextSwitch.
+	///   USER_MODE_CONTEXT_SWITCH is ignored when the process has the user-mode
+	///   CET shadow stack enabled, because ContextSwitch does not switch the shadow stack.
+	bool user_mode_context_switch () const noexcept
+	{
+		return USER_MODE_CONTEXT_SWITCH && user_mode_context_switch_;
+	}
+
+	/// Trim the committed stack of the current fiber.
+	/// 
+	/// If the committed stack exceeds FIBER_STACK_TRIM, decommit pages below
+	/// the current stack pointer down to FIBER_STACK_COMMIT.
+	/// Called by the fiber procedure on a shallow stack.
+	static void trim_stack () noexcept;
+
+private:
+	void create (Fiber& fiber) noexcept;
+	void shrink (Fiber*& garbage) noexcept;
+	static void delete_list (Fiber* list) noexcept;
+	static bool user_shadow_stack () noexcept;
+
+private:
+	const bool user_mode_context_switch_;
+	SRWLOCK lock_;
+	LPFIBER_START_ROUTINE proc_;
+	Fiber* free_;
+	unsigned free_cnt_;
+	unsigned min_free_cnt_; // Minimal free count during the current shrink period
+	ULONGLONG shrink_time_;
+};
+
+}
+}
+}
+
+#endif
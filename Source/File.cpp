@@ -24,6 +24,7 @@
 *  popov.nirvana@gmail.com
 */
 #include "../Port/File.h"
+#include "BlockingRegion.h"
 #include "error2errno.h"
 #include "win32.h"
 
@@ -77,8 +78,12 @@ FileType File::type () noexcept
 void* File::open (uint32_t access, uint32_t share_mode, uint32_t creation_disposition,
 	uint32_t flags_and_attributes, _SECURITY_ATTRIBUTES* psi)
 {
-	HANDLE h = CreateFileW (path (),
-		access, share_mode, psi, creation_disposition, flags_and_attributes, nullptr);
+	HANDLE h;
+	{
+		BlockingRegion blocking;
+		h = CreateFileW (path (),
+			access, share_mode, psi, creation_disposition, flags_and_attributes, nullptr);
+	}
 
 	if (INVALID_HANDLE_VALUE == h)
 		error_check_exist ();
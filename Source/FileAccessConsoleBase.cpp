@@ -24,6 +24,7 @@
 *  popov.nirvana@gmail.com
 */
 #include "FileAccessConsoleBase.h"
+#include "BlockingRegion.h"
 #include "error2errno.h"
 #include "win32.h"
 
@@ -118,7 +119,12 @@ Ref <IO_Request> FileAccessConsoleBase::write_start (const IDL::String& data)
 	Ref <IO_Request> rq = Ref <IO_Request>::create <RequestWrite> ();
 	DWORD cbw;
 	IO_Result res (0, 0);
-	if (!WriteFile (handle_out_, data.data (), (DWORD)data.size (), &cbw, nullptr))
+	BOOL ok;
+	{
+		BlockingRegion blocking;
+		ok = WriteFile (handle_out_, data.data (), (DWORD)data.size (), &cbw, nullptr);
+	}
+	if (!ok)
 		res.error = error2errno (GetLastError ());
 	res.size = cbw;
 	rq->signal (res);
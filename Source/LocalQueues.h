@@ -0,0 +1,274 @@
+/// \file
+/// Per-worker deadline queues with stealing.
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_LOCALQUEUES_H_
+#define NIRVANA_CORE_WINDOWS_LOCALQUEUES_H_
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Set of the per-worker local deadline queues and one global queue.
+/// 
+/// Executors scheduled from a worker thread go to the local queue of this worker.
+/// Executors scheduled from other threads go to the global queue.
+/// Each queue publishes its minimal deadline in a separate cache line.
+/// A worker takes the earliest executor among all queues, but prefers its own local queue
+/// if the local head is not later than the earliest head plus the tolerance.
+/// So the global EDF order holds within the tolerance.
+/// If the own queue can not be used, the worker prefers the queues of the workers
+/// on the same NUMA node within the same tolerance.
+/// 
+/// The class does not depend on Windows API and can be tested on any host.
+/// 
+/// \tparam Queue Priority queue type. Must have the following methods:
+///   bool insert (DeadlineTime, const Val&);
+///   bool delete_min (Val&);
+///   bool reorder (DeadlineTime, const Val&, DeadlineTime old);
+///   DeadlineTime get_min_deadline (); // Returns 0 if the queue is empty.
+template <class Queue>
+class LocalQueues
+{
+public:
+	/// Deadline value meaning the empty queue.
+	static const uint64_t EMPTY = ~(uint64_t)0;
+
+	/// Worker index for the threads which are not workers.
+	static const unsigned NOT_WORKER = ~0U;
+
+	/// Constructor.
+	/// 
+	/// \param global The global queue.
+	/// \param worker_cnt Number of the worker threads.
+	/// \param tolerance EDF tolerance in the deadline units.
+	///   May be changed later with tolerance ().
+	/// \param args Local queue constructor arguments.
+	template <class ... Args>
+	LocalQueues (Queue& global, unsigned worker_cnt, uint64_t tolerance, Args ... args) :
+		tolerance_ (tolerance),
+		worker_cnt_ (worker_cnt),
+		slots_ (worker_cnt + 1)
+	{
+		for (unsigned i = 0; i < worker_cnt; ++i) {
+			locals_.emplace_back (new Queue (args...));
+			slots_ [i].queue = locals_.back ().get ();
+		}
+		slots_ [worker_cnt].node = NOT_WORKER;
+		slots_ [worker_cnt].queue = &global;
+	}
+
+	/// Insert into the local queue of the worker.
+	/// 
+	/// \param worker The worker index or NOT_WORKER.
+	///   The global queue is used for NOT_WORKER.
+	template <class Val>
+	bool insert (unsigned worker, uint64_t deadline, const Val& val)
+	{
+		unsigned i = worker < worker_cnt_ ? worker : worker_cnt_;
+		if (!slots_ [i].queue->insert (deadline, val))
+			return false;
+		refresh (i);
+		return true;
+	}
+
+	/// Extract the earliest executor.
+	/// 
+	/// \param worker The current worker index.
+	/// \param [out] val The extracted value.
+	/// \returns `false` if all queues are empty.
+	template <class Val>
+	bool delete_min (unsigned worker, Val& val)
+	{
+		uint64_t deadline;
+		return delete_min (worker, val, deadline);
+	}
+
+	/// Extract the earliest executor.
+	/// 
+	/// \param worker The current worker index.
+	/// \param [out] val The extracted value.
+	/// \param [out] deadline The published head of the queue the value was taken from.
+	///   It may differ from the value deadline if the queue is changed concurrently.
+	///   EMPTY if unknown.
+	/// \returns `false` if all queues are empty.
+	template <class Val>
+	bool delete_min (unsigned worker, Val& val, uint64_t& deadline)
+	{
+		for (;;) {
+			unsigned best = NOT_WORKER, near = NOT_WORKER;
+			uint64_t best_deadline = EMPTY, near_deadline = EMPTY;
+			unsigned node = worker < worker_cnt_ ? slots_ [worker].node : NOT_WORKER;
+			for (unsigned i = 0; i <= worker_cnt_; ++i) {
+				uint64_t h = slots_ [i].head.load (std::memory_order_acquire);
+				if (h < best_deadline) {
+					best_deadline = h;
+					best = i;
+				}
+				if (h < near_deadline && i != worker && slots_ [i].node == node) {
+					near_deadline = h;
+					near = i;
+				}
+			}
+
+			if (NOT_WORKER == best) {
+				// Published heads may be behind the actual state, check the queues themselves.
+				for (unsigned i = 0; i <= worker_cnt_; ++i) {
+					if (slots_ [i].queue->delete_min (val)) {
+						refresh (i);
+						deadline = EMPTY;
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// Prefer the own local queue, then the same node queues within the tolerance.
+			unsigned from = best;
+			deadline = best_deadline;
+			if (worker < worker_cnt_ && worker != best) {
+				uint64_t h = slots_ [worker].head.load (std::memory_order_acquire);
+				if (h != EMPTY && h - best_deadline <= tolerance_) {
+					from = worker;
+					deadline = h;
+				} else if (near_deadline != EMPTY && near_deadline - best_deadline <= tolerance_) {
+					from = near;
+					deadline = near_deadline;
+				}
+			}
+
+			bool ok = slots_ [from].queue->delete_min (val);
+			refresh (from);
+			if (ok)
+				return true;
+		}
+	}
+
+	/// Change the executor deadline.
+	/// 
+	/// \param worker The current worker index. Its local queue is checked first.
+	template <class Val>
+	bool reorder (unsigned worker, uint64_t deadline, const Val& val, uint64_t old)
+	{
+		if (worker < worker_cnt_ && reorder_in (worker, deadline, val, old))
+			return true;
+		for (unsigned i = worker_cnt_ + 1; i-- > 0;) {
+			if (i != worker && reorder_in (i, deadline, val, old))
+				return true;
+		}
+		return false;
+	}
+
+	/// \returns The earliest published deadline or EMPTY.
+	uint64_t min_deadline () const noexcept
+	{
+		uint64_t ret = EMPTY;
+		for (const Slot& slot : slots_) {
+			uint64_t h = slot.head.load (std::memory_order_acquire);
+			if (ret > h)
+				ret = h;
+		}
+		return ret;
+	}
+
+	void tolerance (uint64_t t) noexcept
+	{
+		tolerance_ = t;
+	}
+
+	/// Set NUMA node of the worker.
+	void node (unsigned worker, unsigned node) noexcept
+	{
+		assert (worker < worker_cnt_);
+		slots_ [worker].node = node;
+	}
+
+	unsigned worker_count () const noexcept
+	{
+		return worker_cnt_;
+	}
+
+private:
+	struct alignas (64) Slot
+	{
+		Slot () :
+			queue (nullptr),
+			head (EMPTY),
+			node (0)
+		{}
+
+		Queue* queue;
+		std::atomic <uint64_t> head;
+		unsigned node;
+	};
+
+	template <class Val>
+	bool reorder_in (unsigned i, uint64_t deadline, const Val& val, uint64_t old)
+	{
+		if (!slots_ [i].queue->reorder (deadline, val, old))
+			return false;
+		refresh (i);
+		return true;
+	}
+
+	uint64_t actual_head (unsigned i) const
+	{
+		uint64_t dt = slots_ [i].queue->get_min_deadline ();
+		return dt ? dt : EMPTY;
+	}
+
+	/// Publish the queue head.
+	/// The store may overwrite the newer value from other thread, so check and repeat.
+	void refresh (unsigned i)
+	{
+		Slot& slot = slots_ [i];
+		for (;;) {
+			uint64_t h = actual_head (i);
+			slot.head.store (h, std::memory_order_release);
+			if (actual_head (i) == h)
+				break;
+		}
+	}
+
+private:
+	uint64_t tolerance_;
+	const unsigned worker_cnt_;
+	std::vector <Slot> slots_;
+	std::vector <std::unique_ptr <Queue> > locals_;
+};
+
+}
+}
+}
+
+#endif
@@ -31,6 +31,7 @@
 #include "ex2signal.h"
 #include <winternl.h>
 #include "DebugLog.h"
+#include "SectionPool.h"
 
 #ifndef NDEBUG
 #include <DbgHelp.h>
@@ -46,6 +47,7 @@ namespace Core {
 namespace Windows {
 
 StaticallyAllocated <AddressSpace <sizeof (void*) == 8> > local_address_space;
+static StaticallyAllocated <SectionPool> section_pool;
 
 #if !defined (_WIN64)
 
@@ -74,8 +76,72 @@ inline ULONG handle_count (HANDLE h)
 	return 0;
 }
 
+static_assert (PageStateShadow::PAGES == PAGES_PER_BLOCK, "PageStateShadow::PAGES");
+
+// Copy-on-write protections are not in the table, such pages are not cached in the shadow.
+const DWORD BlockState::code_protection [1 << PageStateShadow::CODE_BITS] = {
+	0,
+	// Mapped
+	PageState::DECOMMITTED,
+	PageState::READ_WRITE_PRIVATE,
+	PageState::READ_ONLY,
+	PAGE_READONLY,
+	// Unmapped
+	PAGE_READWRITE,
+	PAGE_EXECUTE_READ,
+	PAGE_READONLY
+};
+
+#ifndef NDEBUG
+std::atomic <size_t> BlockState::request_count;
+std::atomic <size_t> BlockState::query_count;
+#endif
+
+bool BlockState::load (const PageStateShadow& shadow, PageStateShadow::Stamp& stamp) noexcept
+{
+	uint8_t codes [PageStateShadow::PAGES];
+	if (!shadow.get (stamp, codes))
+		return false;
+	for (unsigned i = 0; i < PAGES_PER_BLOCK; ++i) {
+		PageState& ps = page_state [i];
+		unsigned code = codes [i];
+		ps.VirtualAttributes.Flags = 0;
+		if (code) {
+			ps.VirtualAttributes.Valid = 1;
+			ps.VirtualAttributes.Shared = code < FIRST_UNMAPPED_CODE;
+			ps.VirtualAttributes.Win32Protection = code_protection [code];
+		}
+	}
+	return true;
+}
+
+void BlockState::save (PageStateShadow& shadow, PageStateShadow::Stamp stamp) const noexcept
+{
+	uint8_t codes [PageStateShadow::PAGES];
+	for (unsigned i = 0; i < PAGES_PER_BLOCK; ++i) {
+		const PageState& ps = page_state [i];
+		unsigned code = 0;
+		if (ps.is_committed ()) {
+			DWORD protection = ps.protection ();
+			unsigned begin = ps.is_mapped () ? 1 : FIRST_UNMAPPED_CODE;
+			unsigned end = ps.is_mapped () ? FIRST_UNMAPPED_CODE : (unsigned)std::size (code_protection);
+			for (code = begin; code < end; ++code) {
+				if (code_protection [code] == protection)
+					break;
+			}
+			if (code == end)
+				return; // Not cacheable
+		}
+		codes [i] = (uint8_t)code;
+	}
+	shadow.update (stamp, codes);
+}
+
 void BlockState::query (HANDLE process)
 {
+#ifndef NDEBUG
+	query_count.fetch_add (1, std::memory_order_relaxed);
+#endif
 	NIRVANA_VERIFY (QueryWorkingSetEx (process, page_state, sizeof (page_state)));
 	PageState* ps = page_state;
 	do {
@@ -105,12 +171,32 @@ const BlockState& Memory::Block::state ()
 {
 	assert (State::RESERVED != state_);
 	if (State::PAGE_STATE_UNKNOWN == state_) {
-		block_state_.query (space_.process ());
+#ifndef NDEBUG
+		BlockState::request_count.fetch_add (1, std::memory_order_relaxed);
+#endif
+		PageStateShadow::Stamp stamp;
+		if (!block_state_.load (page_states (), stamp)) {
+			block_state_.query (space_.process ());
+			block_state_.save (page_states (), stamp);
+		}
 		state_ = State::MAPPED;
 	}
 	return block_state_;
 }
 
+bool Memory::Block::shared ()
+{
+	if (!may_be_shared ())
+		return false;
+	if (handle_count (mapping ()) > 1)
+		return true;
+	// Only this block holds the section now.
+	// Nobody can duplicate the handle while we hold the exclusive lock.
+	if (exclusive_locked ())
+		reset_shared ();
+	return false;
+}
+
 bool Memory::Block::has_data (size_t offset, size_t size, uint32_t mask)
 {
 	if (State::RESERVED == state_)
@@ -172,6 +258,7 @@ restart:
 		size = round_up (offset + size, PAGE_SIZE) - begin;
 		if (!VirtualAlloc ((BYTE*)address () + begin, size, MEM_COMMIT, PageState::READ_WRITE_PRIVATE))
 			throw_NO_MEMORY ();
+		invalidate_state ();
 		ret = PageState::READ_WRITE_PRIVATE;
 	} else {
 		const BlockState& bs = state ();
@@ -190,7 +277,7 @@ restart:
 
 			// If the memory section is shared, we mustn't commit pages.
 			// If the page is not committed and we commit it, it will become committed in another block.
-			if (handle_count (mapping ()) > 1) {
+			if (shared ()) {
 				auto not_committed = page;
 				do {
 					if (PageState::MASK_NOT_COMMITTED & not_committed->state ())
@@ -452,7 +539,7 @@ void Memory::Block::copy_aligned (Block& src_block, void* src, size_t size, unsi
 		DWORD copied_pages_state;
 		if (Nirvana::Memory::READ_ONLY & flags)
 			copied_pages_state = PageState::READ_ONLY;
-		else if (!move || handle_count (src_block.mapping ()) > 1)
+		else if (!move || src_block.shared ())
 			copied_pages_state = PageState::READ_WRITE_SHARED;
 		else
 			copied_pages_state = PageState::READ_WRITE_PRIVATE;
@@ -491,7 +578,7 @@ void Memory::Block::copy_aligned (Block& src_block, void* src, size_t size, unsi
 					page_protection [i] = block_state.page_state [i].protection ();
 				}
 
-				map_copy (src_block.mapping ());
+				map_copy (src_block);
 				adjust_protection (page_protection);
 
 			} else {
@@ -631,7 +718,7 @@ void Memory::Block::change_protection (size_t offset, size_t size, unsigned flag
 	offset = round_down (offset, PAGE_SIZE);
 	offset_end = round_up (offset_end, PAGE_SIZE);
 
-	if (handle_count (mapping ()) <= 1) {
+	if (!shared ()) {
 		// Not shared
 		protect (offset, offset_end - offset, PageState::READ_WRITE_PRIVATE);
 		return;
@@ -686,7 +773,7 @@ bool Memory::Block::is_private (size_t offset, size_t size)
 	for (; pst != pst_end; ++pst) {
 		DWORD state = pst->state ();
 		if ((state & PageState::MASK_RW) && (state & PageState::MASK_MAPPED))
-			return handle_count (mapping ()) <= 1;
+			return !shared ();
 	}
 	return true;
 }
@@ -698,7 +785,9 @@ inline void Memory::query (const void* address, MEMORY_BASIC_INFORMATION& mbi) n
 
 HANDLE Memory::new_mapping ()
 {
-	HANDLE mapping = CreateFileMappingW (INVALID_HANDLE_VALUE, 0, PAGE_EXECUTE_READWRITE | SEC_RESERVE, 0, ALLOCATION_GRANULARITY, 0);
+	HANDLE mapping = section_pool->get ();
+	if (!mapping)
+		mapping = SectionPool::create ();
 	if (!mapping)
 		throw_NO_MEMORY ();
 	return mapping;
@@ -1286,9 +1375,13 @@ bool Memory::initialize () noexcept
 
 	if (!address_space_init ())
 		return false;
-	
-	if (!(exception_handler_ = AddVectoredExceptionHandler (TRUE, &exception_filter)))
+
+	section_pool.construct ();
+	if (!section_pool->initialize ()
+		|| !(exception_handler_ = AddVectoredExceptionHandler (TRUE, &exception_filter))) {
+		section_pool.destruct ();
 		return false;
+	}
 	
 	return true;
 }
@@ -1297,6 +1390,7 @@ void Memory::terminate () noexcept
 {
 	RemoveVectoredExceptionHandler (exception_handler_);
 	
+	section_pool.destruct ();
 	address_space_term ();
 
 	DebugLog::terminate ();
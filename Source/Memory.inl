@@ -128,10 +128,37 @@ struct BlockState
 
 	void query (HANDLE process);
 
+	/// Load the page states from the shadow.
+	/// 
+	/// \param shadow The page state shadow.
+	/// \param [out] stamp The stamp for save ().
+	/// \returns `false` if the shadow is stale.
+	bool load (const PageStateShadow& shadow, PageStateShadow::Stamp& stamp) noexcept;
+
+	/// Save the queried page states to the shadow.
+	/// Does nothing if some page state may be changed without our call.
+	void save (PageStateShadow& shadow, PageStateShadow::Stamp stamp) const noexcept;
+
 	BYTE* address () const
 	{
 		return (BYTE*)page_state [0].VirtualAddress;
 	}
+
+#ifndef NDEBUG
+	/// Number of the block state requests.
+	/// Each request was a kernel query before the shadow was introduced.
+	/// Counted in the debug build only.
+	static std::atomic <size_t> request_count;
+
+	/// Number of the kernel queries.
+	/// Counted in the debug build only.
+	static std::atomic <size_t> query_count;
+#endif
+
+private:
+	// Page state codes. 0 is not committed page.
+	static const DWORD code_protection [1 << PageStateShadow::CODE_BITS];
+	static const unsigned FIRST_UNMAPPED_CODE = 5;
 };
 
 }
@@ -186,6 +213,10 @@ public:
 	/// Obtain the block state
 	const Windows::BlockState& state ();
 
+	/// Check that the memory section is shared.
+	/// The kernel handle count is queried only if the section was ever shared.
+	bool shared ();
+
 private:
 	struct CopyReadOnly
 	{
@@ -29,6 +29,8 @@
 #pragma once
 
 #include "../Port/Scheduler.h"
+#include "SchedulerTelemetry.h"
+#include "win32.h"
 #include <atomic>
 
 namespace Nirvana {
@@ -60,10 +62,63 @@ public:
 
 	virtual void worker_thread_proc () noexcept = 0;
 
+	/// Called by BlockingRegion.
+	/// If the current thread is a worker thread, its core is released.
+	virtual void blocking_begin () noexcept = 0;
+
+	/// Called by BlockingRegion.
+	/// If the core was released, waits until the scheduler grants a core with the executor deadline.
+	virtual void blocking_end () noexcept = 0;
+
+	/// \returns The scheduler or `nullptr` if the scheduler is not created.
+	static SchedulerBase* get () noexcept
+	{
+		return static_cast <SchedulerBase*> (singleton_);
+	}
+
 	void on_error (int err);
 
+	/// Scheduler statistics of the current process.
+	/// \returns `nullptr` if the scheduler is not running.
+	const SchedulerStats* stats () const noexcept
+	{
+		return telemetry_.stats ();
+	}
+
+	SchedulerTelemetry& telemetry () noexcept
+	{
+		return telemetry_;
+	}
+
 protected:
+	/// Blocking region state of a worker thread. Accessed by the owner thread only.
+	/// Written by the owner worker only. Aligned to avoid false sharing in the per-worker arrays.
+	struct alignas (64) BlockingState
+	{
+		BlockingState () :
+			depth (0),
+			core_released (false),
+			core_event (nullptr)
+		{}
+
+		~BlockingState ()
+		{
+			if (core_event)
+				CloseHandle (core_event);
+		}
+
+		BlockingState (const BlockingState&) = delete;
+		BlockingState& operator = (const BlockingState&) = delete;
+
+		unsigned depth;
+		/// The thread released its core in the blocking region and did not get it back.
+		bool core_released;
+		/// Signalled when the core is granted again at the end of the region. Created on the first region.
+		HANDLE core_event;
+	};
+
 	std::atomic <int> error_;
+	SchedulerTelemetry telemetry_;
 };
 
 }
@@ -29,10 +29,13 @@
 #include <SysManager.h>
 #include <Chrono.h>
 #include <ThreadWorker.h>
+#include <ExecDomain.h>
 #include <ORB/Services.h>
 #include "error2errno.h"
 #include "../Port/Security.h"
 #include "MessageBroker.h"
+#include "../Port/Chrono.h"
+#include <BackOff.h>
 
 //#define DEBUG_SHUTDOWN
 
@@ -49,12 +52,15 @@ SchedulerProcess::SchedulerProcess (SchedulerMaster& scheduler, DWORD flags) :
 	semaphore_ (nullptr),
 	pipe_ (INVALID_HANDLE_VALUE),
 	process_handle_ (nullptr),
+	ring_view_ (nullptr),
+	gate_view_ (nullptr),
 	process_id_ (0),
+	buffers_ (scheduler.thread_count (), SchedulerMessage::MAX_FRAME_SIZE),
 	valid_cnt_ (0),
 	used_cores_ (0),
+	queued_ (0),
 	created_items_ (0),
-	terminated_ ATOMIC_FLAG_INIT,
-	buffers_ (scheduler.thread_count (), sizeof (SchedulerMessage::Buffer))
+	terminated_ ATOMIC_FLAG_INIT
 {
 	pipe_ = CreateNamedPipeW (SCHEDULER_PIPE_NAME, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | flags,
 		PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_REJECT_REMOTE_CLIENTS,
@@ -74,6 +80,10 @@ SchedulerProcess::~SchedulerProcess ()
 		CloseHandle (pipe_);
 	if (process_handle_)
 		CloseHandle (process_handle_);
+	if (ring_view_)
+		UnmapViewOfFile (ring_view_);
+	if (gate_view_)
+		UnmapViewOfFile (gate_view_);
 }
 
 inline
@@ -89,7 +99,7 @@ void SchedulerProcess::enqueue_buffer (OVERLAPPED* buf) noexcept
 {
 	_add_ref ();
 	zero (*buf);
-	if (!ReadFile (pipe_, BufferPool::data (buf), sizeof (SchedulerMessage::Buffer), nullptr, buf)) {
+	if (!ReadFile (pipe_, BufferPool::data (buf), SchedulerMessage::MAX_FRAME_SIZE, nullptr, buf)) {
 		uint32_t err = GetLastError ();
 		if (ERROR_BROKEN_PIPE == err)
 			broken_pipe ();
@@ -100,6 +110,39 @@ void SchedulerProcess::enqueue_buffer (OVERLAPPED* buf) noexcept
 	}
 }
 
+bool SchedulerProcess::open_ring () noexcept
+{
+	HANDLE mapping = OpenFileMappingW (FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+		ObjectName (SCHEDULER_RING_PREFIX, process_id_));
+	if (!mapping)
+		return false;
+	size_t size = SchedulerRing <SchedulerMessage::Record>::required_size (SchedulerMessage::RING_CAPACITY);
+	ring_view_ = MapViewOfFile (mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+	CloseHandle (mapping); // The view holds the section
+	if (!ring_view_)
+		return false;
+	if (!ring_.attach (ring_view_, size)) {
+		UnmapViewOfFile (ring_view_);
+		ring_view_ = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool SchedulerProcess::open_gate () noexcept
+{
+	HANDLE mapping = OpenFileMappingW (FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+		ObjectName (SCHEDULER_GATE_PREFIX, process_id_));
+	if (!mapping)
+		return false;
+	gate_view_ = MapViewOfFile (mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof (WorkerGate::Shared));
+	CloseHandle (mapping); // The view holds the section
+	if (!gate_view_)
+		return false;
+	gate_.attach (gate_view_);
+	return true;
+}
+
 inline
 bool SchedulerProcess::start () noexcept
 {
@@ -118,6 +161,20 @@ bool SchedulerProcess::start () noexcept
 		return false;
 	}
 
+	if ((SCHEDULER_RING && !open_ring ()) || !open_gate ()) {
+		CloseHandle (semaphore_);
+		semaphore_ = nullptr;
+		DisconnectNamedPipe (pipe_);
+		return false;
+	}
+
+	// Statistics are optional
+	domain_stats_.open (process_id_, true);
+
+	unsigned quota = DOMAIN_CORE_QUOTA, weight = DOMAIN_CORE_WEIGHT;
+	scheduler_.take_domain_budget (process_id_, quota, weight);
+	budget (quota, weight);
+
 	valid_cnt_.increment ();
 
 	OVERLAPPED* buf = buffers_.begin ();
@@ -144,15 +201,61 @@ void SchedulerProcess::terminate () noexcept
 }
 
 inline
-bool SchedulerProcess::execute () noexcept
+bool SchedulerProcess::execute (DeadlineTime deadline, DeadlineTime delay) noexcept
+{
+	int own_queued = dequeued ();
+	if (!budget_.admit ((unsigned)used_cores_.load (),
+		(unsigned)Port::SystemInfo::hardware_concurrency (), scheduler_.total_weight ())) {
+		// The domain over the budget may borrow the idle capacity only.
+		// The throttled item is granted only if no items of other domains wait in the master queue,
+		// otherwise it is throttled again with the larger delay.
+		if (!delay || scheduler_.queued () > own_queued)
+			return throttle (deadline, delay);
+	}
+
+	if (!grant_core ())
+		return false;
+
+	// Report the deadline misses to the domain.
+	DeadlineTime now = Port::Chrono::deadline_clock ();
+	DeadlineTime lateness = now > deadline ? now - deadline : 0;
+	scheduler_.telemetry ().record (SchedulerStats::LATENESS, lateness);
+	if (lateness)
+		domain_stats_.add (SchedulerStats::DEADLINE_MISSED);
+	return true;
+}
+
+bool SchedulerProcess::throttle (DeadlineTime deadline, DeadlineTime delay) noexcept
+{
+	// Let other domains with the earlier deadlines take the core.
+	// The delay accumulates on each throttling, so a throttled item never moves before
+	// the items that were behind it and finally falls behind all waiting items.
+	DeadlineTime now = Port::Chrono::deadline_clock ();
+	delay += Port::Chrono::make_deadline (THROTTLE_DELAY) - now;
+	domain_stats_.add (SchedulerStats::THROTTLED);
+	domain_stats_.record (SchedulerStats::THROTTLE_DELAY, delay);
+	scheduler_.schedule (std::max (deadline, now) + delay, *this, deadline, delay);
+	return false;
+}
+
+void SchedulerProcess::budget (unsigned quota, unsigned weight) noexcept
+{
+	scheduler_.add_weight ((int)weight - (int)budget_.weight ());
+	budget_.set (quota, weight);
+}
+
+bool SchedulerProcess::grant_core () noexcept
 {
 	if (valid_cnt_.increment_if_not_zero ()) {
 		used_cores_.increment ();
 		bool ret = true;
-		if (!ReleaseSemaphore (semaphore_, 1, nullptr)) {
+		// If no worker thread is blocked, the grant is taken by the spinning or next idle worker.
+		if (gate_.release () && !ReleaseSemaphore (semaphore_, 1, nullptr)) {
 			ret = false;
 			used_cores_.decrement ();
+			scheduler_.telemetry ().add (SchedulerStats::GRANT_FAILED);
 		}
+		update_used_cores ();
 		if (!valid_cnt_.decrement_seq ())
 			terminate ();
 		return ret;
@@ -164,9 +267,18 @@ inline
 void SchedulerProcess::core_free ()
 {
 	used_cores_.decrement ();
+	update_used_cores ();
+	scheduler_.telemetry ().add (SchedulerStats::CORE_FREE);
 	scheduler_.core_free ();
 }
 
+void SchedulerProcess::update_used_cores () noexcept
+{
+	SchedulerStats* stats = domain_stats_.stats ();
+	if (stats)
+		stats->used_cores (used_cores_.load ());
+}
+
 void SchedulerProcess::create_item (bool with_reschedule)
 {
 	scheduler_.create_item (with_reschedule);
@@ -176,7 +288,7 @@ void SchedulerProcess::create_item (bool with_reschedule)
 void SchedulerProcess::delete_item (bool with_reschedule)
 {
 	created_items_.fetch_add (with_reschedule ? -2 : -1, std::memory_order_relaxed);
-	scheduler_.create_item (with_reschedule);
+	scheduler_.delete_item (with_reschedule);
 }
 
 void SchedulerProcess::schedule (DeadlineTime deadline)
@@ -189,9 +301,16 @@ void SchedulerProcess::reschedule (DeadlineTime deadline, DeadlineTime old)
 	scheduler_.reschedule (deadline, *this, old);
 }
 
+void SchedulerProcess::on_error ()
+{
+	// The domain violated the scheduler protocol. Disconnect it as the dead one.
+	broken_pipe ();
+}
+
 void SchedulerProcess::broken_pipe ()
 {
 	if (!terminated_.test_and_set ()) {
+		budget (0, 0);
 		scheduler_.process_terminated (*this);
 		if (!valid_cnt_.decrement_seq ())
 			terminate ();
@@ -222,7 +341,7 @@ void SchedulerProcess::completed (OVERLAPPED* ovl, uint32_t size, uint32_t error
 #endif
 			} else if (valid_cnt_.increment_if_not_zero ()) {
 
-				static const size_t MAX_WORDS = (sizeof (SchedulerMessage::Buffer) + sizeof (LONG_PTR) - 1) / sizeof (LONG_PTR);
+				static const size_t MAX_WORDS = (SchedulerMessage::MAX_FRAME_SIZE + sizeof (LONG_PTR) - 1) / sizeof (LONG_PTR);
 				LONG_PTR buf [MAX_WORDS];
 				LONG_PTR* msg = (LONG_PTR*)BufferPool::data (ovl);
 				real_copy (msg, msg + (size + sizeof (LONG_PTR) - 1) / sizeof (LONG_PTR), buf);
@@ -242,44 +361,18 @@ void SchedulerProcess::completed (OVERLAPPED* ovl, uint32_t size, uint32_t error
 
 void SchedulerProcess::dispatch_message (const void* msg, size_t size)
 {
-	switch (size) {
-		case sizeof (SchedulerMessage::Tagged) : {
-			auto tag = ((SchedulerMessage::Tagged*)msg)->tag;
-			switch (tag) {
-				case SchedulerMessage::Tagged::CREATE_ITEM:
-				case SchedulerMessage::Tagged::CREATE_ITEM2:
-					create_item (SchedulerMessage::Tagged::CREATE_ITEM2 == tag);
-					break;
-				case SchedulerMessage::Tagged::DELETE_ITEM:
-				case SchedulerMessage::Tagged::DELETE_ITEM2:
-					delete_item (SchedulerMessage::Tagged::DELETE_ITEM2 == tag);
-					break;
-				case SchedulerMessage::Tagged::CORE_FREE:
-					core_free ();
-					break;
-
-				default:
-					assert (false);
-			}
-		} break;
-
-		case sizeof (SchedulerMessage::Schedule) :
-			schedule (((SchedulerMessage::Schedule*)msg)->deadline);
-			break;
-
-		case sizeof (SchedulerMessage::ReSchedule) :
-			reschedule (((SchedulerMessage::ReSchedule*)msg)->deadline,
-				((SchedulerMessage::ReSchedule*)msg)->deadline_prev);
-			break;
-
-		default:
-			assert (false);
-	}
+	NIRVANA_VERIFY (SchedulerMessage::parse (msg, size, [this] (const SchedulerMessage::Header& rec) {
+		SchedulerDispatch <SchedulerProcess>::record (*this, rec);
+	}));
 }
 
 SchedulerMaster::SchedulerMaster () :
-	sysdomainid_ (INVALID_HANDLE_VALUE)
-{}
+	sysdomainid_ (INVALID_HANDLE_VALUE),
+	total_weight_ (0),
+	queued_ (0)
+{
+	InitializeSRWLock (&domain_budgets_lock_);
+}
 
 SchedulerMaster::~SchedulerMaster ()
 {
@@ -347,6 +440,7 @@ bool SchedulerMaster::run (StartupSys& startup)
 
 		cleanup_temp_files ();
 		create_folders ();
+		telemetry_.create (sys_process_id);
 
 		if (!create_process (FILE_FLAG_FIRST_PIPE_INSTANCE))
 			throw_INITIALIZE ();
@@ -378,19 +472,25 @@ bool SchedulerMaster::create_process (DWORD flags) noexcept
 void SchedulerMaster::create_item (bool with_reschedule)
 {
 	Base::create_item (with_reschedule);
+	telemetry_.add (SchedulerStats::CREATE_ITEM);
 }
 
 void SchedulerMaster::delete_item (bool with_reschedule) noexcept
 {
 	Base::delete_item (with_reschedule);
+	telemetry_.add (SchedulerStats::DELETE_ITEM);
 }
 
 void SchedulerMaster::schedule (DeadlineTime deadline, Executor& executor) noexcept
 {
 	try {
-		Port::Thread::PriorityBoost boost (SCHEDULER_THREAD_PRIORITY);
+		Port::BackOff::SchedulerOperation op;
+		queued_.fetch_add (1, std::memory_order_relaxed);
 		Base::schedule (deadline, executor);
+		telemetry_.add (SchedulerStats::SCHEDULE);
+		telemetry_.enqueued ();
 	} catch (...) {
+		queued_.fetch_sub (1, std::memory_order_relaxed);
 		on_error (CORBA::SystemException::EC_NO_MEMORY);
 	}
 }
@@ -398,9 +498,11 @@ void SchedulerMaster::schedule (DeadlineTime deadline, Executor& executor) noexc
 bool SchedulerMaster::reschedule (DeadlineTime deadline, Executor& executor, DeadlineTime old) noexcept
 {
 	try {
-		Port::Thread::PriorityBoost boost (SCHEDULER_THREAD_PRIORITY);
-		if (Base::reschedule (deadline, executor, old))
+		Port::BackOff::SchedulerOperation op;
+		if (Base::reschedule (deadline, executor, old)) {
+			telemetry_.add (SchedulerStats::RESCHEDULE);
 			return true;
+		}
 	} catch (...) {
 		on_error (CORBA::SystemException::EC_NO_MEMORY);
 	}
@@ -408,11 +510,18 @@ bool SchedulerMaster::reschedule (DeadlineTime deadline, Executor& executor, Dea
 }
 
 inline
-void SchedulerMaster::schedule (DeadlineTime deadline, SchedulerProcess& process) noexcept
+void SchedulerMaster::schedule (DeadlineTime key, SchedulerProcess& process, DeadlineTime deadline,
+	DeadlineTime delay) noexcept
 {
 	try {
-		Base::schedule (deadline, process);
+		queued_.fetch_add (1, std::memory_order_relaxed);
+		process.enqueued ();
+		Base::schedule (key, SchedulerItem (process, deadline, delay));
+		telemetry_.add (SchedulerStats::SCHEDULE);
+		telemetry_.enqueued ();
 	} catch (...) {
+		process.dequeued ();
+		queued_.fetch_sub (1, std::memory_order_relaxed);
 		on_error (CORBA::SystemException::EC_NO_MEMORY);
 	}
 }
@@ -421,7 +530,8 @@ inline
 void SchedulerMaster::reschedule (DeadlineTime deadline, SchedulerProcess& process, DeadlineTime old) noexcept
 {
 	try {
-		Base::reschedule (deadline, process, old);
+		if (Base::reschedule (deadline, SchedulerItem (process, deadline, 0), old))
+			telemetry_.add (SchedulerStats::RESCHEDULE);
 	} catch (...) {
 		on_error (CORBA::SystemException::EC_NO_MEMORY);
 	}
@@ -468,6 +578,35 @@ void SchedulerMaster::call_sys_domain (SchedulerProcess& process)
 		ESIOP::send_shutdown (process.process_id (), 0); // Shutdown is in the final stage
 }
 
+void SchedulerMaster::domain_budget (ULONG process_id, unsigned quota, unsigned weight)
+{
+	AcquireSRWLockExclusive (&domain_budgets_lock_);
+	try {
+		domain_budgets_.push_back ({ process_id, quota, weight });
+	} catch (...) {
+		ReleaseSRWLockExclusive (&domain_budgets_lock_);
+		throw;
+	}
+	ReleaseSRWLockExclusive (&domain_budgets_lock_);
+}
+
+bool SchedulerMaster::take_domain_budget (ULONG process_id, unsigned& quota, unsigned& weight) noexcept
+{
+	bool found = false;
+	AcquireSRWLockExclusive (&domain_budgets_lock_);
+	for (auto it = domain_budgets_.begin (); it != domain_budgets_.end (); ++it) {
+		if (it->process_id == process_id) {
+			quota = it->quota;
+			weight = it->weight;
+			domain_budgets_.erase (it);
+			found = true;
+			break;
+		}
+	}
+	ReleaseSRWLockExclusive (&domain_budgets_lock_);
+	return found;
+}
+
 inline
 void SchedulerMaster::process_started (SchedulerProcess& process) noexcept
 {
@@ -531,14 +670,113 @@ void SchedulerMaster::shutdown () noexcept
 
 void SchedulerMaster::worker_thread_proc () noexcept
 {
-	worker_threads_.thread_proc ();
+	// Each packet runs an executor, so the packets are not batched.
+	if (!worker_threads_.is_spare ())
+		worker_threads_.thread_proc (1);
+	else {
+		// The spare thread exits when it is idle and not needed.
+		while (worker_threads_.thread_proc (1, BLOCKING_SPARE_RETIRE) && !worker_threads_.retire ())
+			;
+	}
+}
+
+void SchedulerMaster::blocking_begin () noexcept
+{
+	WorkerThreads::WorkerState* state = worker_threads_.current_state ();
+	if (!state || state->depth++ || state->core_released)
+		return;
+
+	if (!state->core_event && !(state->core_event = CreateEventW (nullptr, FALSE, FALSE, nullptr)))
+		return; // Keep the core, we could not get it back.
+
+	// Release the core while the thread is blocked.
+	// The spare thread is started before the release, so the core is used at once.
+	state->core_released = true;
+	if (worker_threads_.core_released ())
+		telemetry_.add (SchedulerStats::SPARE_STARTED);
+	telemetry_.add (SchedulerStats::CORE_FREE);
+	core_free ();
+}
+
+void SchedulerMaster::blocking_end () noexcept
+{
+	WorkerThreads::WorkerState* state = worker_threads_.current_state ();
+	if (!state)
+		return;
+	assert (state->depth);
+	if (--state->depth || !state->core_released)
+		return;
+
+	// Get a core back before the executor continues.
+	// The request is queued with the executor deadline as any other item.
+	ExecDomain* ed = Thread::current ().exec_domain ();
+	DeadlineTime deadline = ed ? ed->deadline () : INFINITE_DEADLINE;
+	try {
+		create_item (false);
+		try {
+			Port::BackOff::SchedulerOperation op;
+			queued_.fetch_add (1, std::memory_order_relaxed);
+			Base::schedule (deadline, SchedulerItem (state->core_event));
+		} catch (...) {
+			queued_.fetch_sub (1, std::memory_order_relaxed);
+			delete_item (false);
+			throw;
+		}
+	} catch (...) {
+		// Continue without the core. It is not freed at the end of the executor.
+		return;
+	}
+	telemetry_.add (SchedulerStats::SCHEDULE);
+	telemetry_.enqueued ();
+	WaitForSingleObject (state->core_event, INFINITE);
+	delete_item (false);
+	state->core_released = false;
+	worker_threads_.core_returned ();
+	telemetry_.add (SchedulerStats::CORE_REACQUIRED);
+}
+
+SchedulerMaster::WorkerThreads::WorkerThreads () :
+	states_ (thread_count ())
+{}
+
+SchedulerMaster::WorkerThreads::WorkerState* SchedulerMaster::WorkerThreads::current_state () noexcept
+{
+	const void* cur = Port::Thread::current (); // May be nullptr
+	Windows::ThreadWorker* begin = threads ();
+	if (cur >= begin && cur < begin + thread_count ())
+		return &states_ [(const Windows::ThreadWorker*)cur - begin];
+	return nullptr;
 }
 
 void SchedulerMaster::WorkerThreads::completed (_OVERLAPPED* ovl, uint32_t size, uint32_t error) noexcept
 {
-	PortableServer::Servant_var <Executor> ref (reinterpret_cast <Executor*> (ovl));
-	static_cast <ThreadWorker&> (Thread::current ()).execute (std::move (ref));
-	SchedulerMaster::singleton ().core_free ();
+	ThreadWorker& worker = static_cast <ThreadWorker&> (Thread::current ());
+	WorkerState* state = current_state ();
+	assert (state);
+	SchedulerMaster& scheduler = SchedulerMaster::singleton ();
+	Executor* executor = reinterpret_cast <Executor*> (ovl);
+	do {
+		PortableServer::Servant_var <Executor> ref (executor);
+		worker.execute (std::move (ref));
+		executor = nullptr;
+		if (state->core_released) {
+			// Released in the blocking region and not got back
+			state->core_released = false;
+			core_returned ();
+		} else {
+			scheduler.telemetry ().add (SchedulerStats::CORE_FREE);
+
+			// If the core is given to a local executor, it is placed into the hand-off slot.
+			state->accepting = true;
+			scheduler.core_free ();
+			state->accepting = false;
+			executor = state->executor;
+			state->executor = nullptr;
+		}
+	} while (executor);
+
+	// The worker returns to the completion port and parks.
+	Port::Thread::revert ();
 }
 
 }
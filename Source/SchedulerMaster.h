@@ -30,14 +30,18 @@
 
 #include "SchedulerBase.h"
 #include <SchedulerImpl.h>
-#include "SchedulerMessage.h"
+#include "SchedulerProtocol.h"
+#include "CoreBudget.h"
+#include "WorkerGate.h"
 #include "CompletionPort.h"
 #include "CompletionPortReceiver.h"
 #include "ThreadPostman.h"
 #include "WorkerThreads.h"
 #include "ObjectName.h"
 #include "BufferPool.h"
+#include "../Port/Chrono.h"
 #include <CORBA/Servant_var.h>
+#include <vector>
 
 namespace Nirvana {
 namespace Core {
@@ -55,6 +59,10 @@ class SchedulerProcess :
 	SchedulerProcess (SchedulerProcess&) = delete;
 	SchedulerProcess& operator = (SchedulerProcess&) = delete;
 
+	/// Deadline delay of the domain item requeued by the budget check.
+	/// The item yields to all domains with the deadlines within this delay.
+	static const TimeBase::TimeT THROTTLE_DELAY = 100 * TimeBase::MILLISECOND;
+
 public:
 	SchedulerProcess (SchedulerMaster& scheduler, DWORD flags = 0);
 	~SchedulerProcess ();
@@ -70,7 +78,28 @@ public:
 			delete this;
 	}
 
-	bool execute () noexcept;
+	/// Grant a core.
+	/// 
+	/// \param deadline The deadline the domain item was scheduled with.
+	/// \param delay The accumulated delay of the item requeued by the budget check. 0 if not throttled.
+	/// \returns `false` if the core was not granted.
+	bool execute (DeadlineTime deadline, DeadlineTime delay) noexcept;
+
+	/// Set the core budget. See CoreBudget.
+	void budget (unsigned quota, unsigned weight) noexcept;
+
+	/// Count the domain item inserted into the master queue.
+	void enqueued () noexcept
+	{
+		queued_.fetch_add (1, std::memory_order_relaxed);
+	}
+
+	/// Count the domain item extracted from the master queue.
+	/// \returns Number of the domain items remaining in the master queue.
+	int dequeued () noexcept
+	{
+		return queued_.fetch_sub (1, std::memory_order_relaxed) - 1;
+	}
 
 	ULONG process_id () const noexcept
 	{
@@ -97,9 +126,22 @@ private:
 	void core_free ();
 	void schedule (DeadlineTime deadline);
 	void reschedule (DeadlineTime deadline, DeadlineTime old);
+	bool grant_core () noexcept;
+	bool throttle (DeadlineTime deadline, DeadlineTime delay) noexcept;
 	void enqueue_buffer (OVERLAPPED* buf) noexcept;
 	void dispatch_message (const void* msg, size_t size);
+	bool open_ring () noexcept;
+	bool open_gate () noexcept;
+	void update_used_cores () noexcept;
 	void broken_pipe ();
+	void on_error ();
+
+	SchedulerRing <SchedulerMessage::Record>& ring () noexcept
+	{
+		return ring_;
+	}
+
+	friend class SchedulerDispatch <SchedulerProcess>;
 
 	virtual void completed (OVERLAPPED* ovl, uint32_t size, uint32_t error) noexcept override;
 
@@ -108,14 +150,29 @@ private:
 	HANDLE semaphore_;
 	HANDLE pipe_;
 	HANDLE process_handle_;
+	void* ring_view_;
+	SchedulerRing <SchedulerMessage::Record> ring_;
+	void* gate_view_;
+	WorkerGate gate_;
+	SchedulerTelemetry domain_stats_; // Statistics of the domain, used_cores is published here
 	ULONG process_id_;
-	RefCounter ref_cnt_;
-	AtomicCounter <false> valid_cnt_;
+	BufferPool buffers_;
+	CoreBudget budget_;
+
+	// Hot counters are grouped by the writers and placed in separate cache lines.
+
+	// Written on each reference copy in the scheduler queue.
+	alignas (64) RefCounter ref_cnt_;
+
+	// Written by the worker threads on grant_core and by the postman threads on core_free.
+	alignas (64) AtomicCounter <false> valid_cnt_;
 	AtomicCounter <false> used_cores_;
+	std::atomic <int> queued_; // Domain items in the master queue
+
+	// Written by the postman threads on the item records.
 	// create_item and delete_item may be out of order, so we need signed counter.
-	std::atomic <int> created_items_;
+	alignas (64) std::atomic <int> created_items_;
 	std::atomic_flag terminated_;
-	BufferPool buffers_;
 };
 
 typedef Ref <SchedulerProcess> SchedulerProcessRef;
@@ -123,22 +180,64 @@ typedef Ref <SchedulerProcess> SchedulerProcessRef;
 class SchedulerItem
 {
 public:
-	SchedulerItem () noexcept
+	SchedulerItem () noexcept :
+		core_event_ (nullptr),
+		deadline_ (0),
+		delay_ (0)
 	{}
 
 	SchedulerItem (SchedulerProcess& process) noexcept :
-		process_ (&process)
+		process_ (&process),
+		core_event_ (nullptr),
+		deadline_ (0),
+		delay_ (0)
+	{}
+
+	/// \param deadline The item deadline.
+	/// \param delay The accumulated delay of the item requeued by the budget check.
+	///   The item is queued with the delayed deadline.
+	SchedulerItem (SchedulerProcess& process, DeadlineTime deadline, DeadlineTime delay) noexcept :
+		process_ (&process),
+		core_event_ (nullptr),
+		deadline_ (deadline),
+		delay_ (delay)
 	{}
 
 	SchedulerItem (Executor& executor) noexcept :
-		local_executor_ (&executor)
+		local_executor_ (&executor),
+		core_event_ (nullptr),
+		deadline_ (0),
+		delay_ (0)
+	{}
+
+	/// A worker thread waits for the core at the end of a blocking region.
+	/// \param core_event The event of the thread. It is signalled when the core is granted.
+	explicit SchedulerItem (HANDLE core_event) noexcept :
+		core_event_ (core_event),
+		deadline_ (0),
+		delay_ (0)
 	{}
 
+	DeadlineTime deadline () const noexcept
+	{
+		return deadline_;
+	}
+
+	DeadlineTime delay () const noexcept
+	{
+		return delay_;
+	}
+
 	SchedulerProcess* process () const noexcept
 	{
 		return process_;
 	}
 
+	HANDLE core_event () const noexcept
+	{
+		return core_event_;
+	}
+
 	Executor* detach_executor () noexcept
 	{
 		return static_cast <PortableServer::Servant_var <Executor>&> (local_executor_)._retn ();
@@ -153,6 +252,9 @@ public:
 private:
 	SchedulerProcessRef process_;
 	Ref <Executor> local_executor_;
+	HANDLE core_event_;
+	DeadlineTime deadline_;
+	DeadlineTime delay_;
 };
 
 /// SchedulerMaster class. 
@@ -189,14 +291,26 @@ public:
 
 	// Implementation of SchedulerBase
 	virtual void worker_thread_proc () noexcept;
+	virtual void blocking_begin () noexcept;
+	virtual void blocking_end () noexcept;
 
 	/// Called by SchedulerImpl
 	bool execute (SchedulerItem item) noexcept
 	{
+		queued_.fetch_sub (1, std::memory_order_relaxed);
+		telemetry_.add (SchedulerStats::DISPATCH);
+		telemetry_.dequeued ();
 		SchedulerProcess* process = item.process ();
-		if (process)
-			return process->execute ();
-		else {
+		if (process) {
+			if (process->execute (item.deadline (), item.delay ()))
+				return true;
+			telemetry_.add (SchedulerStats::EMPTY_DISPATCH);
+			return false;
+		} else if (item.core_event ()) {
+			// The core is passed to the thread waiting at the end of the blocking region.
+			NIRVANA_VERIFY (SetEvent (item.core_event ()));
+			return true;
+		} else {
 			Executor* executor = item.detach_executor ();
 			assert (executor);
 			worker_threads_.execute (*executor);
@@ -204,12 +318,56 @@ public:
 		}
 	}
 
-	void schedule (DeadlineTime deadline, SchedulerProcess& process) noexcept;
+	void schedule (DeadlineTime deadline, SchedulerProcess& process) noexcept
+	{
+		schedule (deadline, process, deadline, 0);
+	}
+
+	/// Queue the domain item.
+	/// 
+	/// \param key The queue key.
+	/// \param process The domain.
+	/// \param deadline The item deadline.
+	/// \param delay The accumulated delay of the throttled item.
+	void schedule (DeadlineTime key, SchedulerProcess& process, DeadlineTime deadline, DeadlineTime delay) noexcept;
 	void reschedule (DeadlineTime deadline, SchedulerProcess& process, DeadlineTime old) noexcept;
 
 	void process_started (SchedulerProcess& process) noexcept;
 	void process_terminated (SchedulerProcess& process) noexcept;
 
+	/// Sum of the domain core budget weights.
+	unsigned total_weight () const noexcept
+	{
+		return total_weight_.load (std::memory_order_relaxed);
+	}
+
+	void add_weight (int w) noexcept
+	{
+		total_weight_.fetch_add (w, std::memory_order_relaxed);
+	}
+
+	/// \returns Number of the items in the master queue.
+	int queued () const noexcept
+	{
+		return queued_.load (std::memory_order_relaxed);
+	}
+
+	/// Set the core budget of the domain process before it connects.
+	/// Called by the system domain on the domain creation.
+	/// 
+	/// \param process_id The domain process id.
+	/// \param quota Maximal number of cores. 0 - unlimited.
+	/// \param weight Share weight. 0 - no share limit.
+	void domain_budget (ULONG process_id, unsigned quota, unsigned weight);
+
+	/// Take the core budget set with domain_budget ().
+	/// 
+	/// \param process_id The domain process id.
+	/// \param [out] quota Maximal number of cores.
+	/// \param [out] weight Share weight.
+	/// \returns `false` if the budget was not set. The output parameters are not changed.
+	bool take_domain_budget (ULONG process_id, unsigned& quota, unsigned& weight) noexcept;
+
 private:
 	static void create_folders ();
 	static void cleanup_temp_files ();
@@ -223,24 +381,78 @@ private:
 	static void call_sys_domain (SchedulerProcess& process);
 
 private:
+	/// Completion port of the worker threads.
+	/// The port concurrency is the number of processors.
+	/// The pool slots above it are the spare threads, see Windows::WorkerThreads.
+	class WorkerPort :
+		public CompletionPort
+	{
+	public:
+		static unsigned int thread_count ()
+		{
+			return CompletionPort::thread_count () + BLOCKING_SPARE_WORKERS_MAX;
+		}
+	};
+
 	/// Helper class for executing in the current process.
+	/// 
+	/// A worker thread that completed its executor releases the core.
+	/// If the released core is given to a local executor, the same worker thread runs it
+	/// without the completion port round trip.
 	class WorkerThreads :
-		public Windows::WorkerThreads <CompletionPort>,
+		public Windows::WorkerThreads <WorkerPort>,
 		public CompletionPortReceiver
 	{
 	public:
+		WorkerThreads ();
+
 		void execute (Executor& executor) noexcept
 		{
-			post (*this, reinterpret_cast <OVERLAPPED*> (&executor), 0);
+			WorkerState* state = current_state ();
+			if (state && state->accepting && !state->executor)
+				state->executor = &executor;
+			else
+				post (*this, reinterpret_cast <OVERLAPPED*> (&executor), 0);
 		}
 
+		/// State of the worker thread. Accessed by the owner thread only.
+		struct WorkerState : BlockingState
+		{
+			WorkerState () :
+				executor (nullptr),
+				accepting (false)
+			{}
+
+			/// Hand-off slot.
+			Executor* executor;
+			bool accepting;
+		};
+
+		/// \returns State of the current thread or `nullptr` if it is not a worker thread.
+		WorkerState* current_state () noexcept;
+
 	private:
 		virtual void completed (_OVERLAPPED* ovl, uint32_t size, uint32_t error) noexcept override;
 
+	private:
+		std::vector <WorkerState> states_;
 	}
 	worker_threads_;
 
 	HANDLE sysdomainid_;
+	std::atomic <unsigned> total_weight_;
+	std::atomic <int> queued_;
+
+	struct DomainBudget
+	{
+		ULONG process_id;
+		unsigned quota;
+		unsigned weight;
+	};
+
+	// Budgets of the created domains which are not connected yet.
+	std::vector <DomainBudget> domain_budgets_;
+	SRWLOCK domain_budgets_lock_;
 };
 
 }
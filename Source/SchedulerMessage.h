@@ -30,61 +30,210 @@
 #pragma once
 
 #include <Nirvana/NirvanaBase.h>
+#include <algorithm>
+#include <assert.h>
 
 #define SCHEDULER_PIPE_NAME WINWCS ("\\\\.\\pipe\\") OBJ_NAME_PREFIX WINWCS ("/scheduler")
 #define SCHEDULER_SEMAPHORE_PREFIX OBJ_NAME_PREFIX WINWCS ("/scheduler")
+#define SCHEDULER_RING_PREFIX OBJ_NAME_PREFIX WINWCS ("/schedring")
+#define SCHEDULER_GATE_PREFIX OBJ_NAME_PREFIX WINWCS ("/schedgate")
 
 namespace Nirvana {
 namespace Core {
 namespace Windows {
 
+/// If `true`, protection domains pass scheduler records through the shared memory ring.
+/// The pipe is used only to signal the non-empty ring and to detect the domain termination.
+const bool SCHEDULER_RING = true;
+
 #pragma pack (push, 1)
 
+/// Scheduler pipe message.
+///
+/// A pipe message is a frame that contains one or more records.
+/// Each record starts with the Header that defines the record type.
 struct SchedulerMessage
 {
-	struct Schedule
+	struct Header
+	{
+		enum Tag : uint8_t
+		{
+			SCHEDULE,
+			RESCHEDULE,
+			CORE_FREE,
+			CREATE_ITEM,
+			CREATE_ITEM2,
+			DELETE_ITEM,
+			DELETE_ITEM2,
+			RING_SIGNAL, ///< Records are available in the shared ring
+			CREATE_SCHEDULE,  ///< CREATE_ITEM + SCHEDULE
+			CREATE2_SCHEDULE, ///< CREATE_ITEM2 + SCHEDULE
+			DELETE_CORE_FREE,  ///< DELETE_ITEM + CORE_FREE
+			DELETE2_CORE_FREE, ///< DELETE_ITEM2 + CORE_FREE
+
+			TAG_COUNT
+		}
+		tag;
+
+		Header (Tag t) :
+			tag (t)
+		{}
+	};
+
+	struct Schedule : Header
 	{
 		DeadlineTime deadline;
 
 		Schedule (const DeadlineTime& dt) :
+			Header (SCHEDULE),
 			deadline (dt)
 		{}
 	};
 
-	struct ReSchedule
+	/// Create item and schedule it in one record.
+	struct CreateSchedule : Header
+	{
+		DeadlineTime deadline;
+
+		CreateSchedule (const DeadlineTime& dt, bool with_reschedule) :
+			Header (with_reschedule ? CREATE2_SCHEDULE : CREATE_SCHEDULE),
+			deadline (dt)
+		{}
+	};
+
+	struct ReSchedule : Header
 	{
 		DeadlineTime deadline;
 		DeadlineTime deadline_prev;
 
 		ReSchedule (const DeadlineTime& dt, const DeadlineTime& old) :
+			Header (RESCHEDULE),
 			deadline (dt),
 			deadline_prev (old)
 		{}
 	};
 
-	struct Tagged
+	/// Record without data.
+	struct Tagged : Header
 	{
-		enum Tag : uint32_t
+		Tagged (Tag t) :
+			Header (t)
 		{
-			CORE_FREE,
-			CREATE_ITEM,
-			CREATE_ITEM2,
-			DELETE_ITEM,
-			DELETE_ITEM2
+			assert (t >= CORE_FREE && t < TAG_COUNT && t != CREATE_SCHEDULE && t != CREATE2_SCHEDULE);
 		}
-		tag;
-
-		Tagged (Tag t) :
-			tag (t)
-		{}
 	};
 
-	union Buffer
+	/// Returns record size or 0 for the invalid tag.
+	static size_t record_size (Header::Tag tag) noexcept
 	{
+		switch (tag) {
+			case Header::SCHEDULE:
+				return sizeof (Schedule);
+			case Header::RESCHEDULE:
+				return sizeof (ReSchedule);
+			case Header::CREATE_SCHEDULE:
+			case Header::CREATE2_SCHEDULE:
+				return sizeof (CreateSchedule);
+			default:
+				return tag < Header::TAG_COUNT ? sizeof (Tagged) : 0;
+		}
+	}
+
+	/// Any record. Used as the shared ring element.
+	union Record
+	{
+		Header header;
 		Schedule schedule;
+		CreateSchedule create_schedule;
 		ReSchedule reschedule;
 		Tagged tagged;
+
+		Record () noexcept
+		{}
+
+		template <class Rec>
+		Record (const Rec& rec) noexcept
+		{
+			static_assert (sizeof (Rec) <= sizeof (Record), "Invalid record");
+			const uint8_t* src = (const uint8_t*)&rec;
+			std::copy (src, src + sizeof (Rec), (uint8_t*)this);
+		}
+	};
+
+	/// Maximal frame size. Master reads the pipe with buffers of this size.
+	static const size_t MAX_FRAME_SIZE = 512;
+
+	/// Shared ring capacity in records.
+	static const uint32_t RING_CAPACITY = 4096;
+
+	/// Frame builder.
+	class Frame
+	{
+	public:
+		Frame () noexcept :
+			size_ (0)
+		{}
+
+		/// Append record to the frame.
+		/// 
+		/// \param rec The record.
+		/// \returns `false` if the frame has no space for the record.
+		template <class Rec>
+		bool append (const Rec& rec) noexcept
+		{
+			if (size_ + sizeof (Rec) > MAX_FRAME_SIZE)
+				return false;
+			const uint8_t* src = (const uint8_t*)&rec;
+			std::copy (src, src + sizeof (Rec), data_ + size_);
+			size_ += sizeof (Rec);
+			return true;
+		}
+
+		const void* data () const noexcept
+		{
+			return data_;
+		}
+
+		size_t size () const noexcept
+		{
+			return size_;
+		}
+
+		bool empty () const noexcept
+		{
+			return !size_;
+		}
+
+		void clear () noexcept
+		{
+			size_ = 0;
+		}
+
+	private:
+		size_t size_;
+		uint8_t data_ [MAX_FRAME_SIZE];
 	};
+
+	/// Parse frame.
+	/// 
+	/// \param frame The frame data.
+	/// \param size The frame size.
+	/// \param f Functor that is called for each record as `f (const Header&)`.
+	/// \returns `false` if the frame is malformed. Records preceding the malformed one are processed.
+	template <class F>
+	static bool parse (const void* frame, size_t size, F f)
+	{
+		const uint8_t* p = (const uint8_t*)frame;
+		const uint8_t* end = p + size;
+		while (p < end) {
+			size_t cb = record_size (((const Header*)p)->tag);
+			if (!cb || (size_t)(end - p) < cb)
+				return false;
+			f (*(const Header*)p);
+			p += cb;
+		}
+		return true;
+	}
 };
 
 #pragma pack (pop)
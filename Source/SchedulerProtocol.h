@@ -0,0 +1,213 @@
+/// \file
+/// Scheduler record protocol of the protection domain and the master.
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_SCHEDULERPROTOCOL_H_
+#define NIRVANA_CORE_WINDOWS_SCHEDULERPROTOCOL_H_
+#pragma once
+
+#include "SchedulerMessage.h"
+#include "SchedulerRing.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Protection domain side. Builds the item records.
+///
+/// The item records of a worker thread are deferred to be sent together with
+/// the following SCHEDULE or CORE_FREE record: CREATE_SCHEDULE and DELETE_CORE_FREE.
+/// The deferred record is sent before any other item record and at the end of the executor.
+/// If an item is deleted before its deferred creation was sent, nothing is sent at all.
+///
+/// Each function gets the deferred record slot of the worker thread or `nullptr` for the other threads,
+/// and the functor that sends a record. The functor must accept any record type.
+///
+/// The class does not depend on Windows API, so the scheduler simulator uses it as is.
+class SchedulerDeferral
+{
+public:
+	typedef SchedulerMessage::Header::Tag Tag;
+
+	template <class Send>
+	static void create_item (Tag* deferred, bool with_reschedule, Send send)
+	{
+		// Created item is usually scheduled immediately by the same thread.
+		flush (deferred, send);
+		defer (deferred, with_reschedule ?
+			SchedulerMessage::Header::CREATE_ITEM2
+			:
+			SchedulerMessage::Header::CREATE_ITEM, send);
+	}
+
+	template <class Send>
+	static void delete_item (Tag* deferred, bool with_reschedule, Send send)
+	{
+		// Deleted item is usually followed by the core release of the same worker.
+		Tag tag = take (deferred);
+		if (tag != (with_reschedule ?
+			SchedulerMessage::Header::CREATE_ITEM2 : SchedulerMessage::Header::CREATE_ITEM)) {
+			if (SchedulerMessage::Header::TAG_COUNT != tag)
+				send (SchedulerMessage::Tagged (tag));
+			defer (deferred, with_reschedule ?
+				SchedulerMessage::Header::DELETE_ITEM2
+				:
+				SchedulerMessage::Header::DELETE_ITEM, send);
+		} // Otherwise the item was not announced to the master yet, nothing to send.
+	}
+
+	template <class Send>
+	static void schedule (Tag* deferred, DeadlineTime deadline, Send send)
+	{
+		Tag tag = take (deferred);
+		if (SchedulerMessage::Header::CREATE_ITEM == tag || SchedulerMessage::Header::CREATE_ITEM2 == tag)
+			send (SchedulerMessage::CreateSchedule (deadline, SchedulerMessage::Header::CREATE_ITEM2 == tag));
+		else {
+			if (SchedulerMessage::Header::TAG_COUNT != tag)
+				send (SchedulerMessage::Tagged (tag));
+			send (SchedulerMessage::Schedule (deadline));
+		}
+	}
+
+	template <class Send>
+	static void core_free (Tag* deferred, Send send)
+	{
+		Tag tag = take (deferred);
+		if (SchedulerMessage::Header::DELETE_ITEM == tag || SchedulerMessage::Header::DELETE_ITEM2 == tag)
+			send (SchedulerMessage::Tagged (SchedulerMessage::Header::DELETE_ITEM == tag ?
+				SchedulerMessage::Header::DELETE_CORE_FREE
+				:
+				SchedulerMessage::Header::DELETE2_CORE_FREE
+			));
+		else {
+			if (SchedulerMessage::Header::TAG_COUNT != tag)
+				send (SchedulerMessage::Tagged (tag));
+			send (SchedulerMessage::Tagged (SchedulerMessage::Header::CORE_FREE));
+		}
+	}
+
+	/// Send the deferred item record, if any.
+	template <class Send>
+	static void flush (Tag* deferred, Send send)
+	{
+		Tag tag = take (deferred);
+		if (SchedulerMessage::Header::TAG_COUNT != tag)
+			send (SchedulerMessage::Tagged (tag));
+	}
+
+private:
+	/// \returns The deferred record tag or TAG_COUNT if there is no deferred record.
+	static Tag take (Tag* deferred) noexcept
+	{
+		if (!deferred)
+			return SchedulerMessage::Header::TAG_COUNT;
+		Tag tag = *deferred;
+		*deferred = SchedulerMessage::Header::TAG_COUNT;
+		return tag;
+	}
+
+	template <class Send>
+	static void defer (Tag* deferred, Tag tag, Send& send)
+	{
+		if (deferred) {
+			assert (SchedulerMessage::Header::TAG_COUNT == *deferred);
+			*deferred = tag;
+		} else
+			send (SchedulerMessage::Tagged (tag));
+	}
+};
+
+/// Master side. Dispatches the records of a protection domain.
+///
+/// \tparam Process The domain accounting: SchedulerProcess or the simulator model.
+///   Provides create_item (bool), delete_item (bool), schedule (DeadlineTime),
+///   reschedule (DeadlineTime, DeadlineTime), core_free (), ring () and on_error ().
+template <class Process>
+class SchedulerDispatch
+{
+public:
+	static void record (Process& process, const SchedulerMessage::Header& rec)
+	{
+		switch (rec.tag) {
+			case SchedulerMessage::Header::SCHEDULE:
+				process.schedule (static_cast <const SchedulerMessage::Schedule&> (rec).deadline);
+				break;
+
+			case SchedulerMessage::Header::RESCHEDULE: {
+				const SchedulerMessage::ReSchedule& r = static_cast <const SchedulerMessage::ReSchedule&> (rec);
+				process.reschedule (r.deadline, r.deadline_prev);
+			} break;
+
+			case SchedulerMessage::Header::CORE_FREE:
+				process.core_free ();
+				break;
+
+			case SchedulerMessage::Header::CREATE_ITEM:
+			case SchedulerMessage::Header::CREATE_ITEM2:
+				process.create_item (SchedulerMessage::Header::CREATE_ITEM2 == rec.tag);
+				break;
+
+			case SchedulerMessage::Header::DELETE_ITEM:
+			case SchedulerMessage::Header::DELETE_ITEM2:
+				process.delete_item (SchedulerMessage::Header::DELETE_ITEM2 == rec.tag);
+				break;
+
+			case SchedulerMessage::Header::CREATE_SCHEDULE:
+			case SchedulerMessage::Header::CREATE2_SCHEDULE:
+				process.create_item (SchedulerMessage::Header::CREATE2_SCHEDULE == rec.tag);
+				process.schedule (static_cast <const SchedulerMessage::CreateSchedule&> (rec).deadline);
+				break;
+
+			case SchedulerMessage::Header::DELETE_CORE_FREE:
+			case SchedulerMessage::Header::DELETE2_CORE_FREE:
+				process.delete_item (SchedulerMessage::Header::DELETE2_CORE_FREE == rec.tag);
+				process.core_free ();
+				break;
+
+			case SchedulerMessage::Header::RING_SIGNAL: {
+				// Ring records are written by the other process, so we validate tags here.
+				SchedulerRing <SchedulerMessage::Record>& ring = process.ring ();
+				if (ring.is_attached ()) {
+					if (!ring.drain ([&process] (const SchedulerMessage::Record& r) {
+						if (SchedulerMessage::Header::RING_SIGNAL != r.header.tag
+							&& SchedulerMessage::record_size (r.header.tag))
+							record (process, r.header);
+					}))
+						process.on_error ();
+				}
+			} break;
+
+			default:
+				assert (false);
+		}
+	}
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,247 @@
+/// \file
+/// Lock-free record ring in the shared memory.
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_SCHEDULERRING_H_
+#define NIRVANA_CORE_WINDOWS_SCHEDULERRING_H_
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <atomic>
+#include <type_traits>
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Bounded lock-free ring of fixed-size records placed in the shared memory section.
+/// 
+/// The ring does not contain pointers and uses only 32-bit atomics,
+/// so the layout is the same for 32-bit and 64-bit processes.
+/// Any number of producers and consumers is allowed. Each cell has a sequence number
+/// that tells whether the cell is ready for write or for read.
+/// 
+/// The ring does not depend on Windows API and can be tested on any host.
+/// 
+/// \tparam T Record type. Must be trivially copyable.
+template <class T>
+class SchedulerRing
+{
+	static_assert (std::is_trivially_copyable <T>::value, "Record must be trivially copyable");
+
+public:
+	/// Size of the shared memory required for the ring.
+	/// 
+	/// \param capacity Ring capacity, must be power of 2.
+	static size_t required_size (uint32_t capacity) noexcept
+	{
+		return sizeof (Control) + sizeof (Cell) * capacity;
+	}
+
+	SchedulerRing () noexcept :
+		control_ (nullptr),
+		cells_ (nullptr),
+		mask_ (0)
+	{}
+
+	/// Attach to the existing ring.
+	/// 
+	/// \param mem Shared memory.
+	/// \param size Shared memory size.
+	/// \returns `false` if the memory does not contain a valid ring.
+	bool attach (void* mem, size_t size) noexcept
+	{
+		if (size < sizeof (Control))
+			return false;
+		Control* control = (Control*)mem;
+		// Keep the mask locally, the shared memory may be modified by other process.
+		uint32_t mask = control->mask;
+		uint32_t capacity = mask + 1;
+		if (!capacity || (capacity & mask) || required_size (capacity) > size)
+			return false;
+		control_ = control;
+		cells_ = (Cell*)(control + 1);
+		mask_ = mask;
+		return true;
+	}
+
+	/// Create a new ring.
+	/// 
+	/// \param mem Zero-initialized shared memory.
+	/// \param size Shared memory size.
+	/// \param capacity Ring capacity, must be power of 2.
+	/// \returns `false` if memory size is too small.
+	bool create (void* mem, size_t size, uint32_t capacity) noexcept
+	{
+		assert (capacity && !(capacity & (capacity - 1)));
+		if (required_size (capacity) > size)
+			return false;
+		Control* control = (Control*)mem;
+		control->mask = capacity - 1;
+		Cell* cells = (Cell*)(control + 1);
+		for (uint32_t i = 0; i < capacity; ++i) {
+			cells [i].sequence.store (i, std::memory_order_relaxed);
+		}
+		control->enqueue_pos.store (0, std::memory_order_relaxed);
+		control->dequeue_pos.store (0, std::memory_order_relaxed);
+		control->pending.store (0, std::memory_order_release);
+		control_ = control;
+		cells_ = cells;
+		mask_ = control->mask;
+		return true;
+	}
+
+	bool is_attached () const noexcept
+	{
+		return control_ != nullptr;
+	}
+
+	/// Append record.
+	/// 
+	/// \param rec The record.
+	/// \param [out] signal `true` if the ring was empty and the consumer must be signalled.
+	/// \returns `false` if the ring is full.
+	bool push (const T& rec, bool& signal) noexcept
+	{
+		Cell* cell;
+		uint32_t pos = control_->enqueue_pos.load (std::memory_order_relaxed);
+		for (;;) {
+			cell = cells_ + (pos & mask_);
+			uint32_t seq = cell->sequence.load (std::memory_order_acquire);
+			int32_t dif = (int32_t)(seq - pos);
+			if (0 == dif) {
+				if (control_->enqueue_pos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (dif < 0)
+				return false; // Full
+			else
+				pos = control_->enqueue_pos.load (std::memory_order_relaxed);
+		}
+		cell->data = rec;
+		cell->sequence.store (pos + 1, std::memory_order_release);
+
+		// The record is published before it is counted, so the consumer that sees
+		// the pending count will find the record.
+		signal = 0 == control_->pending.fetch_add (1, std::memory_order_acq_rel);
+		return true;
+	}
+
+	/// Extract record.
+	/// 
+	/// \param [out] rec The record.
+	/// \returns `false` if the ring is empty.
+	bool pop (T& rec) noexcept
+	{
+		Cell* cell;
+		uint32_t pos = control_->dequeue_pos.load (std::memory_order_relaxed);
+		for (;;) {
+			cell = cells_ + (pos & mask_);
+			uint32_t seq = cell->sequence.load (std::memory_order_acquire);
+			int32_t dif = (int32_t)(seq - (pos + 1));
+			if (0 == dif) {
+				if (control_->dequeue_pos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (dif < 0)
+				return false; // Empty
+			else {
+				// Other consumer extracted the record and must have moved the position.
+				uint32_t cur = control_->dequeue_pos.load (std::memory_order_relaxed);
+				if (cur == pos)
+					return false; // The shared data is corrupted
+				pos = cur;
+			}
+		}
+		rec = cell->data;
+		cell->sequence.store (pos + mask_ + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Extract all records counted as pending.
+	/// 
+	/// Called by the single consumer when it was signalled.
+	/// Returns when the pending count falls to zero, so the next push will signal again.
+	/// 
+	/// The control data is writable by the producer process, so the loop is bounded:
+	/// it repeats only while the records are actually extracted.
+	/// 
+	/// \param f Functor called for each record as `f (const T&)`.
+	/// \returns `false` if the pending count is inconsistent with the ring content.
+	template <class F>
+	bool drain (F f)
+	{
+		const int32_t capacity = (int32_t)(mask_ + 1);
+		for (;;) {
+			int32_t cnt = 0;
+			T rec;
+			while (pop (rec)) {
+				++cnt;
+				f (rec);
+			}
+			int32_t remaining = control_->pending.fetch_sub (cnt, std::memory_order_acq_rel) - cnt;
+			// Negative means that some extracted records were not counted by the producers yet.
+			// Their counting will not signal, so we are done.
+			if (remaining <= 0)
+				return true;
+			// The records are published before they are counted.
+			// If the counted records were not found, the counter is bogus.
+			if (!cnt || remaining > capacity)
+				return false;
+			// Some records were pushed after the last pop, try again.
+		}
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic <uint32_t> sequence;
+		T data;
+	};
+
+	// Positions are separated to avoid false sharing between producers and consumers.
+	struct Control
+	{
+		uint32_t mask;
+		uint8_t pad0 [60];
+		std::atomic <uint32_t> enqueue_pos;
+		uint8_t pad1 [60];
+		std::atomic <uint32_t> dequeue_pos;
+		uint8_t pad2 [60];
+		std::atomic <int32_t> pending;
+		uint8_t pad3 [60];
+	};
+
+	Control* control_;
+	Cell* cells_;
+	uint32_t mask_;
+};
+
+}
+}
+}
+
+#endif
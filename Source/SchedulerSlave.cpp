@@ -27,10 +27,12 @@
 #include <Scheduler.h>
 #include <StartupProt.h>
 #include <ThreadWorker.h>
-#include "SchedulerMessage.h"
+#include <ExecDomain.h>
 #include "app_data.h"
 #include "ObjectName.h"
 #include "MessageBroker.h"
+#include "../Port/Chrono.h"
+#include <BackOff.h>
 #include <unrecoverable_error.h>
 
 //#define DEBUG_SHUTDOWN
@@ -48,8 +50,20 @@ SchedulerSlave::SchedulerSlave () :
 	terminate_event_ (nullptr),
 	watchdog_thread_ (nullptr),
 	scheduler_pipe_ (INVALID_HANDLE_VALUE),
-	queue_ (Port::SystemInfo::hardware_concurrency ())
-{}
+	frame_writing_ (false),
+	ring_mapping_ (nullptr),
+	ring_view_ (nullptr),
+	gate_mapping_ (nullptr),
+	gate_view_ (nullptr),
+	queue_ (Port::SystemInfo::hardware_concurrency ()),
+	// The spare worker threads use the global queue.
+	queues_ (queue_, Port::SystemInfo::hardware_concurrency (), 0, Port::SystemInfo::hardware_concurrency ()),
+	workers_ (WorkerSemaphore::thread_count ()),
+	core_waiters_ (0)
+{
+	InitializeSRWLock (&frame_lock_);
+	InitializeConditionVariable (&frame_taken_);
+}
 
 SchedulerSlave::~SchedulerSlave ()
 {
@@ -63,6 +77,15 @@ SchedulerSlave::~SchedulerSlave ()
 		CloseHandle (scheduler_pipe_);
 
 	worker_threads_.terminate ();
+
+	if (ring_view_)
+		UnmapViewOfFile (ring_view_);
+	if (ring_mapping_)
+		CloseHandle (ring_mapping_);
+	if (gate_view_)
+		UnmapViewOfFile (gate_view_);
+	if (gate_mapping_)
+		CloseHandle (gate_mapping_);
 	
 	if (sys_process_)
 		CloseHandle (sys_process_);
@@ -88,12 +111,22 @@ bool SchedulerSlave::run (StartupProt& startup, DeadlineTime startup_deadline)
 		throw_INITIALIZE ();
 
 	cur_process_id = GetCurrentProcessId ();
+	telemetry_.create (cur_process_id);
+
 	HANDLE sem = CreateSemaphoreW (nullptr, 0, (LONG)Port::SystemInfo::hardware_concurrency (),
 		ObjectName (SCHEDULER_SEMAPHORE_PREFIX, cur_process_id));
 	if (!sem)
 		throw_INITIALIZE ();
 
 	worker_threads_.semaphore (sem);
+	queues_.tolerance ((LOCAL_QUEUE_TOLERANCE * Port::Chrono::deadline_clock_frequency () + 9999999) / 10000000);
+	for (unsigned i = 0; i < queues_.worker_count (); ++i) {
+		queues_.node (i, SystemTopology::placement ().node (i));
+	}
+	create_gate ();
+
+	if (SCHEDULER_RING)
+		create_ring ();
 
 	Windows::MessageBroker::create (); // Create mailslot
 
@@ -106,44 +139,162 @@ bool SchedulerSlave::run (StartupProt& startup, DeadlineTime startup_deadline)
 	return true;
 }
 
+void SchedulerSlave::create_ring ()
+{
+	// The ring is created before the pipe connection, so master always finds it in the process start.
+	size_t size = SchedulerRing <SchedulerMessage::Record>::required_size (SchedulerMessage::RING_CAPACITY);
+	if (!(ring_mapping_ = CreateFileMappingW (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size,
+		ObjectName (SCHEDULER_RING_PREFIX, cur_process_id))))
+		throw_INITIALIZE ();
+	if (!(ring_view_ = MapViewOfFile (ring_mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size)))
+		throw_INITIALIZE ();
+	NIRVANA_VERIFY (ring_.create (ring_view_, size, SchedulerMessage::RING_CAPACITY));
+}
+
+void SchedulerSlave::create_gate ()
+{
+	if (!(gate_mapping_ = CreateFileMappingW (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+		sizeof (WorkerGate::Shared), ObjectName (SCHEDULER_GATE_PREFIX, cur_process_id))))
+		throw_INITIALIZE ();
+	if (!(gate_view_ = MapViewOfFile (gate_mapping_, FILE_MAP_ALL_ACCESS, 0, 0, sizeof (WorkerGate::Shared))))
+		throw_INITIALIZE ();
+	worker_threads_.gate (gate_view_);
+}
+
+template <class Rec>
+void SchedulerSlave::send (const Rec& rec)
+{
+	if (ring_.is_attached ()) {
+		bool signal;
+		if (ring_.push (rec, signal)) {
+			if (signal)
+				post (SchedulerMessage::Tagged (SchedulerMessage::Header::RING_SIGNAL));
+			return;
+		}
+		// The ring is full, use the pipe.
+		telemetry_.add (SchedulerStats::RING_FULL);
+	}
+	post (rec);
+}
+
+template <class Rec>
+void SchedulerSlave::post (const Rec& rec)
+{
+	// The thread that finds no write in progress becomes the writer.
+	// It writes the current frame and then all records appended by other threads meanwhile.
+	// Other threads just append their records and return without the kernel call.
+	AcquireSRWLockExclusive (&frame_lock_);
+	while (!frame_.append (rec)) {
+		// The frame is full and the writer is busy. Wait until the writer takes the frame.
+		// Writing it from this thread could reorder the records of the other threads.
+		assert (frame_writing_);
+		SleepConditionVariableSRW (&frame_taken_, &frame_lock_, INFINITE, 0);
+	}
+
+	if (frame_writing_) {
+		ReleaseSRWLockExclusive (&frame_lock_);
+		return;
+	}
+
+	frame_writing_ = true;
+	SchedulerMessage::Frame out;
+	do {
+		out = frame_;
+		frame_.clear ();
+		ReleaseSRWLockExclusive (&frame_lock_);
+		WakeAllConditionVariable (&frame_taken_);
+		try {
+			write (out);
+		} catch (...) {
+			AcquireSRWLockExclusive (&frame_lock_);
+			frame_writing_ = false;
+			ReleaseSRWLockExclusive (&frame_lock_);
+			throw;
+		}
+		AcquireSRWLockExclusive (&frame_lock_);
+	} while (!frame_.empty ());
+	frame_writing_ = false;
+	ReleaseSRWLockExclusive (&frame_lock_);
+}
+
 void SchedulerSlave::create_item (bool with_reschedule)
 {
 	try {
-		send (SchedulerMessage::Tagged (with_reschedule ?
-			SchedulerMessage::Tagged::CREATE_ITEM2
-			:
-			SchedulerMessage::Tagged::CREATE_ITEM
-		));
+		SchedulerDeferral::create_item (deferred (worker_index ()), with_reschedule, sender ());
 	} catch (const CORBA::SystemException& ex) {
 		on_error (ex.__code ());
 	}
 	queue_.create_item ();
 	if (with_reschedule)
 		queue_.create_item ();
+	telemetry_.add (SchedulerStats::CREATE_ITEM);
 }
 
 void SchedulerSlave::delete_item (bool with_reschedule) noexcept
 {
 	try {
-		send (SchedulerMessage::Tagged (with_reschedule ?
-			SchedulerMessage::Tagged::DELETE_ITEM2
-			:
-			SchedulerMessage::Tagged::DELETE_ITEM
-		));
+		SchedulerDeferral::delete_item (deferred (worker_index ()), with_reschedule, sender ());
 	} catch (const CORBA::SystemException& ex) {
 		on_error (ex.__code ());
 	}
 	queue_.delete_item ();
 	if (with_reschedule)
 		queue_.delete_item ();
+	telemetry_.add (SchedulerStats::DELETE_ITEM);
+}
+
+unsigned SchedulerSlave::worker_index () noexcept
+{
+	const void* cur = Port::Thread::current (); // May be nullptr
+	ThreadWorker* begin = worker_threads_.threads ();
+	if (cur >= begin && cur < begin + worker_threads_.thread_count ())
+		return (unsigned)((const ThreadWorker*)cur - begin);
+	return LocalQueues <Queue>::NOT_WORKER;
+}
+
+void SchedulerSlave::insert (unsigned worker, DeadlineTime deadline, Executor& executor) noexcept
+{
+	Port::BackOff::SchedulerOperation op;
+	if (LocalQueues <Queue>::NOT_WORKER != worker) {
+		try {
+			if (queues_.insert (worker, deadline, &executor))
+				return;
+		} catch (...) {
+			// Local queue node allocation failed. Use the node reserved in the global queue.
+		}
+	}
+	NIRVANA_VERIFY (queues_.insert (LocalQueues <Queue>::NOT_WORKER, deadline, &executor));
+}
+
+bool SchedulerSlave::delete_min (unsigned worker, Ref <Executor>& executor) noexcept
+{
+	uint64_t deadline;
+	bool found;
+	{
+		Port::BackOff::SchedulerOperation op;
+		found = queues_.delete_min (worker, executor, deadline);
+	}
+	if (!found) {
+		telemetry_.add (SchedulerStats::EMPTY_DISPATCH);
+		return false;
+	}
+	telemetry_.add (SchedulerStats::DISPATCH);
+	telemetry_.dequeued ();
+	if (LocalQueues <Queue>::EMPTY != deadline) {
+		DeadlineTime now = Port::Chrono::deadline_clock ();
+		telemetry_.record (SchedulerStats::LATENESS, now > deadline ? now - deadline : 0);
+	}
+	return true;
 }
 
 void SchedulerSlave::schedule (DeadlineTime deadline, Executor& executor) noexcept
 {
 	try {
-		Port::Thread::PriorityBoost boost;
-		NIRVANA_VERIFY (queue_.insert (deadline, &executor));
-		send (SchedulerMessage::Schedule (deadline));
+		telemetry_.add (SchedulerStats::SCHEDULE);
+		telemetry_.enqueued ();
+		unsigned worker = worker_index ();
+		insert (worker, deadline, executor);
+		SchedulerDeferral::schedule (deferred (worker), deadline, sender ());
 	} catch (const CORBA::SystemException& ex) {
 		on_error (ex.__code ());
 	}
@@ -152,9 +303,12 @@ void SchedulerSlave::schedule (DeadlineTime deadline, Executor& executor) noexce
 bool SchedulerSlave::reschedule (DeadlineTime deadline, Executor& executor, DeadlineTime old) noexcept
 {
 	try {
-		Port::Thread::PriorityBoost boost;
-		if (!queue_.reorder (deadline, &executor, old))
-			return false;
+		{
+			Port::BackOff::SchedulerOperation op;
+			if (!queues_.reorder (worker_index (), deadline, &executor, old))
+				return false;
+		}
+		telemetry_.add (SchedulerStats::RESCHEDULE);
 		send (SchedulerMessage::ReSchedule (deadline, old));
 	} catch (const CORBA::SystemException& ex) {
 		on_error (ex.__code ());
@@ -177,14 +331,21 @@ void SchedulerSlave::shutdown () noexcept
 
 void SchedulerSlave::worker_thread_proc () noexcept
 {
-	worker_threads_.thread_proc (*this);
+	if (!worker_threads_.is_spare ())
+		worker_threads_.thread_proc (*this);
+	else {
+		// The spare thread exits when it is idle and not needed.
+		while (worker_threads_.thread_proc (*this, BLOCKING_SPARE_RETIRE) && !worker_threads_.retire ())
+			;
+	}
 }
 
 inline
-void SchedulerSlave::core_free () noexcept
+void SchedulerSlave::core_free (unsigned worker) noexcept
 {
 	try {
-		send (SchedulerMessage::Tagged (SchedulerMessage::Tagged::CORE_FREE));
+		telemetry_.add (SchedulerStats::CORE_FREE);
+		SchedulerDeferral::core_free (deferred (worker), sender ());
 	} catch (const CORBA::SystemException& ex) {
 		on_error (ex.__code ());
 	}
@@ -192,16 +353,105 @@ void SchedulerSlave::core_free () noexcept
 
 void SchedulerSlave::execute () noexcept
 {
+	// The granted core is passed to a thread waiting at the end of a blocking region first.
+	// The grants are not bound to the items, so the executor takes the grant of the waiter later.
+	if (core_waiters_.load (std::memory_order_acquire) && pass_core ())
+		return;
+
 	ThreadWorker& worker = static_cast <ThreadWorker&> (Thread::current ());
+	unsigned worker_idx = (unsigned)(&worker - worker_threads_.threads ());
 
 	Ref <Executor> executor;
-	{
-		Port::Thread::PriorityBoost boost (&worker);
-		NIRVANA_VERIFY (queue_.delete_min (executor));
-	}
+	WorkerState& blocking = workers_ [worker_idx];
+	NIRVANA_VERIFY (delete_min (worker_idx, executor));
 	worker.execute (std::move (executor));
 
-	core_free ();
+	if (blocking.core_released) {
+		// Released in the blocking region and not got back
+		blocking.core_released = false;
+		worker_threads_.core_returned ();
+		try {
+			SchedulerDeferral::flush (deferred (worker_idx), sender ());
+		} catch (const CORBA::SystemException& ex) {
+			on_error (ex.__code ());
+		}
+	} else
+		core_free (worker_idx);
+}
+
+void SchedulerSlave::blocking_begin () noexcept
+{
+	unsigned worker_idx = worker_index ();
+	if (LocalQueues <Queue>::NOT_WORKER == worker_idx)
+		return;
+	WorkerState& state = workers_ [worker_idx];
+	if (state.depth++ || state.core_released)
+		return;
+
+	if (!state.core_event && !(state.core_event = CreateEventW (nullptr, FALSE, FALSE, nullptr)))
+		return; // Keep the core, we could not get it back.
+
+	// Return the core to the master while the thread is blocked.
+	// The spare thread is started before the release, so the core is used at once.
+	state.core_released = true;
+	if (worker_threads_.core_released ())
+		telemetry_.add (SchedulerStats::SPARE_STARTED);
+	core_free (worker_idx);
+}
+
+void SchedulerSlave::blocking_end () noexcept
+{
+	unsigned worker_idx = worker_index ();
+	if (LocalQueues <Queue>::NOT_WORKER == worker_idx)
+		return;
+	WorkerState& state = workers_ [worker_idx];
+	assert (state.depth);
+	if (--state.depth || !state.core_released)
+		return;
+
+	// Get a core back before the executor continues.
+	// The master grants it for an item with the executor deadline as for any other item.
+	ExecDomain* ed = Thread::current ().exec_domain ();
+	DeadlineTime deadline = ed ? ed->deadline () : INFINITE_DEADLINE;
+	state.core_wait.store (true, std::memory_order_relaxed);
+	core_waiters_.fetch_add (1, std::memory_order_release);
+	try {
+		SchedulerDeferral::create_item (deferred (worker_idx), false, sender ());
+		SchedulerDeferral::schedule (deferred (worker_idx), deadline, sender ());
+	} catch (const CORBA::SystemException& ex) {
+		on_error (ex.__code ());
+		if (take_core_waiter (state))
+			return; // Continue without the core. It is not freed at the end of the executor.
+	}
+	WaitForSingleObject (state.core_event, INFINITE);
+	try {
+		SchedulerDeferral::delete_item (deferred (worker_idx), false, sender ());
+	} catch (const CORBA::SystemException& ex) {
+		on_error (ex.__code ());
+	}
+	state.core_released = false;
+	worker_threads_.core_returned ();
+	telemetry_.add (SchedulerStats::CORE_REACQUIRED);
+}
+
+bool SchedulerSlave::take_core_waiter (WorkerState& state) noexcept
+{
+	bool wait = true;
+	if (!state.core_wait.compare_exchange_strong (wait, false, std::memory_order_acquire))
+		return false;
+	core_waiters_.fetch_sub (1, std::memory_order_relaxed);
+	return true;
+}
+
+bool SchedulerSlave::pass_core () noexcept
+{
+	for (WorkerState& state : workers_) {
+		if (state.core_wait.load (std::memory_order_relaxed) && take_core_waiter (state)) {
+			NIRVANA_VERIFY (SetEvent (state.core_event));
+			return true;
+		}
+	}
+	return false;
 }
 
 DWORD WINAPI SchedulerSlave::s_watchdog_thread_proc (void* _this)
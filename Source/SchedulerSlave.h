@@ -31,6 +31,8 @@
 #include "SchedulerBase.h"
 #include "WorkerThreads.h"
 #include "WorkerSemaphore.h"
+#include "SchedulerProtocol.h"
+#include "LocalQueues.h"
 #include <PriorityQueueReorder.h>
 #include <SkipListWithPool.h>
 
@@ -64,18 +66,65 @@ public:
 
 	// Implementation of SchedulerBase
 	virtual void worker_thread_proc () noexcept;
+	virtual void blocking_begin () noexcept;
+	virtual void blocking_end () noexcept;
 
 	// Called from worker thread.
 	void execute () noexcept;
 
 private:
-	void core_free () noexcept;
+	typedef PriorityQueueReorder <Ref <Executor>, SKIP_LIST_DEFAULT_LEVELS> Queue;
 
-	template <class MSG>
-	void send (const MSG& msg) const
+	/// EDF tolerance for the local queues.
+	static const TimeBase::TimeT LOCAL_QUEUE_TOLERANCE = TimeBase::MILLISECOND / 10;
+
+	/// Free the core of the worker.
+	/// A deferred DELETE_ITEM record of the worker is combined with the core release.
+	void core_free (unsigned worker) noexcept;
+
+	/// \returns The local queue index of the current thread or LocalQueues::NOT_WORKER.
+	unsigned worker_index () noexcept;
+
+	/// Insert executor into the local queue of the worker or into the global queue.
+	void insert (unsigned worker, DeadlineTime deadline, Executor& executor) noexcept;
+
+	/// \returns The deferred item record slot of the worker or `nullptr` for other threads.
+	///   See SchedulerDeferral.
+	SchedulerMessage::Header::Tag* deferred (unsigned worker) noexcept
+	{
+		return LocalQueues <Queue>::NOT_WORKER != worker ? &workers_ [worker].deferred : nullptr;
+	}
+
+	/// \returns The functor to send records for SchedulerDeferral.
+	auto sender () noexcept
+	{
+		return [this] (const auto& rec) { send (rec); };
+	}
+
+	/// Extract the earliest executor and update the statistics.
+	bool delete_min (unsigned worker, Ref <Executor>& executor) noexcept;
+
+	/// Send a record to the master.
+	/// 
+	/// If the shared ring is available, the record is placed into the ring
+	/// and the master is signalled over the pipe only when the ring was empty.
+	template <class Rec>
+	void send (const Rec& rec);
+
+	/// Send a record over the pipe.
+	/// 
+	/// Records sent concurrently from several threads are combined into one pipe message.
+	/// All pipe writes are made by one writer thread at a time, so the records keep their order.
+	template <class Rec>
+	void post (const Rec& rec);
+
+	void create_ring ();
+	void create_gate ();
+
+	void write (const SchedulerMessage::Frame& frame) const
 	{
 		DWORD cb;
-		if (!WriteFile (scheduler_pipe_, &msg, sizeof (MSG), &cb, nullptr))
+		if (!WriteFile (scheduler_pipe_, frame.data (), (DWORD)frame.size (), &cb, nullptr))
 			throw_COMM_FAILURE ();
 	}
 
@@ -86,7 +135,42 @@ private:
 	HANDLE terminate_event_;
 	HANDLE watchdog_thread_;
 	HANDLE scheduler_pipe_;
-	SkipListWithPool <PriorityQueueReorder <Ref <Executor>, SKIP_LIST_DEFAULT_LEVELS> > queue_;
+	SRWLOCK frame_lock_;
+	CONDITION_VARIABLE frame_taken_; // Signalled when the writer takes the frame
+	bool frame_writing_;
+	SchedulerMessage::Frame frame_;
+	HANDLE ring_mapping_;
+	void* ring_view_;
+	SchedulerRing <SchedulerMessage::Record> ring_;
+	HANDLE gate_mapping_;
+	void* gate_view_;
+	SkipListWithPool <Queue> queue_; // Global queue for the submissions from other threads
+	LocalQueues <Queue> queues_;
+	/// Per-worker state.
+	/// 
+	/// The item records of the worker thread are deferred, see SchedulerDeferral.
+	struct WorkerState : BlockingState
+	{
+		WorkerState () :
+			deferred (SchedulerMessage::Header::TAG_COUNT),
+			core_wait (false)
+		{}
+
+		SchedulerMessage::Header::Tag deferred;
+		/// The thread waits for a core at the end of the blocking region.
+		std::atomic <bool> core_wait;
+	};
+
+	/// Take the waiting state of the thread.
+	/// \returns `false` if the core was already passed to the thread.
+	bool take_core_waiter (WorkerState& state) noexcept;
+
+	/// Pass the granted core to a thread waiting at the end of a blocking region.
+	/// \returns `false` if there are no waiting threads.
+	bool pass_core () noexcept;
+
+	std::vector <WorkerState> workers_;
+	std::atomic <int> core_waiters_;
 	WorkerThreads <WorkerSemaphore> worker_threads_;
 };
 
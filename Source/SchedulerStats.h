@@ -0,0 +1,280 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_SCHEDULERSTATS_H_
+#define NIRVANA_CORE_WINDOWS_SCHEDULERSTATS_H_
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Scheduler telemetry of one process.
+/// 
+/// Counters and histograms are split into stripes selected by the current processor number,
+/// so updates from the different processors do not share cache lines.
+/// On the systems with more than STRIPES processors, the processors with the same
+/// number modulo STRIPES share a stripe, so the stripes are not strictly per-processor.
+/// All updates are relaxed atomic increments.
+/// 
+/// The object has a fixed layout and is placed into the named shared memory section.
+/// A diagnostic tool maps the section and takes snapshots while the system is running.
+/// Message rates are the counter differences between two snapshots.
+/// 
+/// The class does not depend on Windows API and can be tested on any host.
+class SchedulerStats
+{
+public:
+	static const uint32_t VERSION = 5;
+
+	/// Number of the stripes.
+	static const unsigned STRIPES = 16;
+
+	enum Counter
+	{
+		SCHEDULE,     ///< Schedule requests
+		RESCHEDULE,   ///< Reschedule requests
+		CORE_FREE,    ///< Core releases
+		CREATE_ITEM,  ///< Queue item reservations
+		DELETE_ITEM,  ///< Queue item releases
+		DISPATCH,     ///< Executors dispatched (slave) or cores granted (master)
+		EMPTY_DISPATCH, ///< Granted core found nothing to do, or stale master item
+		GRANT_FAILED, ///< ReleaseSemaphore failures
+		RING_FULL,    ///< Records sent over the pipe because the shared ring was full
+		THROTTLED,    ///< Grants deferred because the domain exceeded its core budget
+		DEADLINE_MISSED, ///< Cores granted to the domain after the item deadline
+		SPARE_STARTED, ///< Spare worker threads started for the blocking regions
+		CORE_REACQUIRED, ///< Cores granted again at the end of the blocking regions
+
+		COUNTER_COUNT
+	};
+
+	enum Histogram
+	{
+		LATENESS,     ///< Deadline lateness at dispatch (slave) or at core grant (master) in the deadline clock ticks. 0 if in time.
+		QUEUE_DEPTH,  ///< Queue depth at dispatch
+		THROTTLE_DELAY, ///< Accumulated delay of the throttled domain item in the deadline clock ticks
+
+		HISTOGRAM_COUNT
+	};
+
+	/// Log-linear histogram buckets.
+	/// Values below SUB_BUCKETS have own buckets, larger ones have relative error 1/SUB_BUCKETS.
+	static const unsigned SUB_BITS = 3;
+	static const unsigned SUB_BUCKETS = 1 << SUB_BITS;
+	static const unsigned BUCKETS = SUB_BUCKETS + (64 - SUB_BITS) * SUB_BUCKETS;
+
+	static unsigned bucket (uint64_t v) noexcept
+	{
+		if (v < SUB_BUCKETS)
+			return (unsigned)v;
+		unsigned e = msb (v);
+		return SUB_BUCKETS + (e - SUB_BITS) * SUB_BUCKETS + (unsigned)((v >> (e - SUB_BITS)) & (SUB_BUCKETS - 1));
+	}
+
+	/// \returns The minimal value of the bucket.
+	static uint64_t bucket_min (unsigned b) noexcept
+	{
+		if (b < SUB_BUCKETS)
+			return b;
+		unsigned e = (b - SUB_BUCKETS) / SUB_BUCKETS + SUB_BITS;
+		uint64_t sub = (b - SUB_BUCKETS) % SUB_BUCKETS;
+		return ((uint64_t)SUB_BUCKETS + sub) << (e - SUB_BITS);
+	}
+
+	/// Consistent copy of the statistics.
+	struct Snapshot
+	{
+		uint64_t clock_frequency;
+		uint64_t counters [COUNTER_COUNT];
+		int64_t queue_depth;
+		int64_t used_cores;
+		uint64_t histograms [HISTOGRAM_COUNT][BUCKETS];
+
+		uint64_t count (Histogram h) const noexcept
+		{
+			uint64_t cnt = 0;
+			for (unsigned b = 0; b < BUCKETS; ++b) {
+				cnt += histograms [h][b];
+			}
+			return cnt;
+		}
+
+		/// \param p Percentile 0..100.
+		/// \returns Lower bound of the bucket containing the percentile.
+		uint64_t percentile (Histogram h, unsigned p) const noexcept
+		{
+			uint64_t total = count (h);
+			if (!total)
+				return 0;
+			uint64_t rank = (total - 1) * p / 100 + 1;
+			uint64_t cnt = 0;
+			for (unsigned b = 0; b < BUCKETS; ++b) {
+				cnt += histograms [h][b];
+				if (cnt >= rank)
+					return bucket_min (b);
+			}
+			return bucket_min (BUCKETS - 1);
+		}
+	};
+
+	/// Initialize the zero-filled shared memory.
+	void create (uint64_t clock_frequency) noexcept
+	{
+		clock_frequency_ = clock_frequency;
+		version_.store (VERSION, std::memory_order_release);
+	}
+
+	/// \returns `false` if the memory does not contain the statistics of the known version.
+	bool valid () const noexcept
+	{
+		return version_.load (std::memory_order_acquire) == VERSION;
+	}
+
+	/// Increment counter.
+	/// 
+	/// \param cpu The current processor number.
+	void add (unsigned cpu, Counter c, uint64_t n = 1) noexcept
+	{
+		stripes_ [cpu % STRIPES].counters [c].fetch_add (n, std::memory_order_relaxed);
+	}
+
+	/// Record histogram value.
+	/// 
+	/// \param cpu The current processor number.
+	void record (unsigned cpu, Histogram h, uint64_t v) noexcept
+	{
+		stripes_ [cpu % STRIPES].histograms [h][bucket (v)].fetch_add (1, std::memory_order_relaxed);
+	}
+
+	/// Item was added to the queue.
+	/// 
+	/// \param cpu The current processor number.
+	void enqueued (unsigned cpu) noexcept
+	{
+		stripes_ [cpu % STRIPES].queue_depth.fetch_add (1, std::memory_order_relaxed);
+	}
+
+	/// Item was extracted from the queue.
+	/// Records the queue depth histogram.
+	/// 
+	/// \param cpu The current processor number.
+	void dequeued (unsigned cpu) noexcept
+	{
+		int64_t depth = queue_depth ();
+		stripes_ [cpu % STRIPES].queue_depth.fetch_sub (1, std::memory_order_relaxed);
+		record (cpu, QUEUE_DEPTH, depth > 0 ? (uint64_t)depth : 0);
+	}
+
+	/// \returns The current queue depth.
+	///   An item may be added and extracted on different processors,
+	///   so the depth is the sum of all stripes. The sum is read without RMW operations.
+	int64_t queue_depth () const noexcept
+	{
+		int64_t depth = 0;
+		for (const Stripe& stripe : stripes_) {
+			depth += stripe.queue_depth.load (std::memory_order_relaxed);
+		}
+		return depth;
+	}
+
+	/// Set the number of the cores used by the domain. Updated by the master.
+	void used_cores (int64_t cnt) noexcept
+	{
+		used_cores_.store (cnt, std::memory_order_relaxed);
+	}
+
+	/// Take snapshot. May be called concurrently with the updates.
+	/// The counters are read one by one, so the snapshot is not atomic,
+	/// but each value is not less than in the previous snapshot.
+	void snapshot (Snapshot& s) const noexcept
+	{
+		s.clock_frequency = clock_frequency_;
+		for (unsigned c = 0; c < COUNTER_COUNT; ++c) {
+			uint64_t sum = 0;
+			for (const Stripe& stripe : stripes_) {
+				sum += stripe.counters [c].load (std::memory_order_relaxed);
+			}
+			s.counters [c] = sum;
+		}
+		s.queue_depth = queue_depth ();
+		s.used_cores = used_cores_.load (std::memory_order_relaxed);
+		for (unsigned h = 0; h < HISTOGRAM_COUNT; ++h) {
+			for (unsigned b = 0; b < BUCKETS; ++b) {
+				uint64_t sum = 0;
+				for (const Stripe& stripe : stripes_) {
+					sum += stripe.histograms [h][b].load (std::memory_order_relaxed);
+				}
+				s.histograms [h][b] = sum;
+			}
+		}
+	}
+
+private:
+	static unsigned msb (uint64_t v) noexcept
+	{
+#ifdef _MSC_VER
+#ifdef _WIN64
+		unsigned long i;
+		_BitScanReverse64 (&i, v);
+		return i;
+#else
+		unsigned long i;
+		if (_BitScanReverse (&i, (unsigned long)(v >> 32)))
+			return i + 32;
+		_BitScanReverse (&i, (unsigned long)v);
+		return i;
+#endif
+#else
+		return 63 - __builtin_clzll (v);
+#endif
+	}
+
+	struct alignas (64) Stripe
+	{
+		std::atomic <uint64_t> counters [COUNTER_COUNT];
+		std::atomic <int64_t> queue_depth;
+		std::atomic <uint64_t> histograms [HISTOGRAM_COUNT][BUCKETS];
+	};
+
+	std::atomic <uint32_t> version_;
+	uint64_t clock_frequency_;
+	alignas (64) std::atomic <int64_t> used_cores_;
+	Stripe stripes_ [STRIPES];
+};
+
+}
+}
+}
+
+#endif
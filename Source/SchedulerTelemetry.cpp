@@ -0,0 +1,93 @@
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "SchedulerTelemetry.h"
+#include "win32.h"
+#include "ObjectName.h"
+#include "SystemTopology.h"
+#include "../Port/Chrono.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+void SchedulerTelemetry::create (unsigned process_id)
+{
+	assert (!stats_);
+	if (!(mapping_ = CreateFileMappingW (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+		sizeof (SchedulerStats), ObjectName (SCHEDULER_STATS_PREFIX, process_id))))
+		throw_INITIALIZE ();
+	if (!(stats_ = (SchedulerStats*)MapViewOfFile (mapping_, FILE_MAP_ALL_ACCESS, 0, 0, sizeof (SchedulerStats)))) {
+		CloseHandle (mapping_);
+		mapping_ = nullptr;
+		throw_INITIALIZE ();
+	}
+	// The section memory is zero-filled
+	stats_->create (Port::Chrono::deadline_clock_frequency ());
+}
+
+bool SchedulerTelemetry::open (unsigned process_id, bool write) noexcept
+{
+	assert (!stats_);
+	DWORD access = write ? FILE_MAP_READ | FILE_MAP_WRITE : FILE_MAP_READ;
+	HANDLE mapping = OpenFileMappingW (access, FALSE, ObjectName (SCHEDULER_STATS_PREFIX, process_id));
+	if (!mapping)
+		return false;
+	SchedulerStats* stats = (SchedulerStats*)MapViewOfFile (mapping, access, 0, 0, sizeof (SchedulerStats));
+	CloseHandle (mapping); // The view holds the section
+	if (!stats)
+		return false;
+	if (!stats->valid ()) {
+		UnmapViewOfFile (stats);
+		return false;
+	}
+	stats_ = stats;
+	return true;
+}
+
+void SchedulerTelemetry::close () noexcept
+{
+	if (stats_) {
+		UnmapViewOfFile (stats_);
+		stats_ = nullptr;
+	}
+	if (mapping_) {
+		CloseHandle (mapping_);
+		mapping_ = nullptr;
+	}
+}
+
+unsigned SchedulerTelemetry::cpu () noexcept
+{
+	// GetCurrentProcessorNumber is the number in the current group only,
+	// so the processors with the same number in different groups would share a stripe.
+	PROCESSOR_NUMBER pn;
+	GetCurrentProcessorNumberEx (&pn);
+	return SystemTopology::sequential_number (pn.Group, pn.Number);
+}
+
+}
+}
+}
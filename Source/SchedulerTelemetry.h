@@ -0,0 +1,114 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_SCHEDULERTELEMETRY_H_
+#define NIRVANA_CORE_WINDOWS_SCHEDULERTELEMETRY_H_
+#pragma once
+
+#include "SchedulerStats.h"
+
+#define SCHEDULER_STATS_PREFIX OBJ_NAME_PREFIX WINWCS ("/schedstats")
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Named shared memory section with the SchedulerStats of a process.
+/// 
+/// Each scheduler creates the section for its own process.
+/// The master also opens the sections of the protection domains to publish the used cores.
+/// Diagnostic tools open the sections read-only and poll them with SchedulerStats::snapshot ().
+class SchedulerTelemetry
+{
+	SchedulerTelemetry (const SchedulerTelemetry&) = delete;
+	SchedulerTelemetry& operator = (const SchedulerTelemetry&) = delete;
+
+public:
+	SchedulerTelemetry () noexcept :
+		mapping_ (nullptr),
+		stats_ (nullptr)
+	{}
+
+	~SchedulerTelemetry ()
+	{
+		close ();
+	}
+
+	/// Create the section for the current process.
+	void create (unsigned process_id);
+
+	/// Open the section of a process.
+	/// 
+	/// \param process_id The process id.
+	/// \param write `true` to update the statistics.
+	/// \returns `false` if the section does not exist.
+	bool open (unsigned process_id, bool write) noexcept;
+
+	void close () noexcept;
+
+	/// \returns The statistics or `nullptr` if the section is not created yet.
+	SchedulerStats* stats () const noexcept
+	{
+		return stats_;
+	}
+
+	/// Stripe index for the current thread.
+	static unsigned cpu () noexcept;
+
+	void add (SchedulerStats::Counter c) noexcept
+	{
+		if (stats_)
+			stats_->add (cpu (), c);
+	}
+
+	void record (SchedulerStats::Histogram h, uint64_t v) noexcept
+	{
+		if (stats_)
+			stats_->record (cpu (), h, v);
+	}
+
+	void enqueued () noexcept
+	{
+		if (stats_)
+			stats_->enqueued (cpu ());
+	}
+
+	void dequeued () noexcept
+	{
+		if (stats_)
+			stats_->dequeued (cpu ());
+	}
+
+private:
+	void* mapping_;
+	SchedulerStats* stats_;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "SectionPool.h"
+#include <Nirvana/Nirvana.h>
+#include <algorithm>
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+SectionPool::SectionPool () noexcept :
+	terminate_event_ (nullptr),
+	refill_event_ (nullptr),
+	thread_ (nullptr),
+	count_ (0),
+	target_ (SECTION_POOL_MIN),
+	taken_ (0)
+{
+	InitializeSRWLock (&lock_);
+}
+
+SectionPool::~SectionPool ()
+{
+	if (thread_) {
+		SetEvent (terminate_event_);
+		WaitForSingleObject (thread_, INFINITE);
+		CloseHandle (thread_);
+	}
+	if (refill_event_)
+		CloseHandle (refill_event_);
+	if (terminate_event_)
+		CloseHandle (terminate_event_);
+	for (HANDLE* p = stock_, *end = stock_ + count_; p != end; ++p) {
+		CloseHandle (*p);
+	}
+}
+
+bool SectionPool::initialize () noexcept
+{
+	if (!(terminate_event_ = CreateEventW (nullptr, TRUE, FALSE, nullptr)))
+		return false;
+	if (!(refill_event_ = CreateEventW (nullptr, FALSE, FALSE, nullptr)))
+		return false;
+	if (!(thread_ = CreateThread (nullptr, NEUTRAL_FIBER_STACK_RESERVE, s_thread_proc,
+		this, STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr)))
+		return false;
+	SetThreadPriority (thread_, SECTION_POOL_THREAD_PRIORITY);
+	return true;
+}
+
+HANDLE SectionPool::create () noexcept
+{
+	return CreateFileMappingW (INVALID_HANDLE_VALUE, 0, PAGE_EXECUTE_READWRITE | SEC_RESERVE, 0,
+		ALLOCATION_GRANULARITY, 0);
+}
+
+HANDLE SectionPool::get () noexcept
+{
+	HANDLE h = nullptr;
+	AcquireSRWLockExclusive (&lock_);
+	if (count_)
+		h = stock_ [--count_];
+	// The first section taken in the period also wakes the idle thread to resume the adaptation.
+	bool wake = !taken_++ || count_ < target_ / 2;
+	ReleaseSRWLockExclusive (&lock_);
+	if (wake)
+		SetEvent (refill_event_);
+	return h;
+}
+
+void SectionPool::adapt () noexcept
+{
+	AcquireSRWLockExclusive (&lock_);
+	target_ = std::min (std::max (std::max (taken_, target_ / 2), SECTION_POOL_MIN), SECTION_POOL_MAX);
+	taken_ = 0;
+	ReleaseSRWLockExclusive (&lock_);
+}
+
+bool SectionPool::idle () noexcept
+{
+	AcquireSRWLockShared (&lock_);
+	bool ret = !taken_ && count_ >= target_ && std::max (target_ / 2, SECTION_POOL_MIN) >= target_;
+	ReleaseSRWLockShared (&lock_);
+	return ret;
+}
+
+void SectionPool::refill () noexcept
+{
+	// Trim the excess
+	for (;;) {
+		HANDLE h = nullptr;
+		AcquireSRWLockExclusive (&lock_);
+		if (count_ > target_)
+			h = stock_ [--count_];
+		ReleaseSRWLockExclusive (&lock_);
+		if (!h)
+			break;
+		CloseHandle (h);
+	}
+
+	// Create the missing sections out of the lock
+	for (;;) {
+		AcquireSRWLockShared (&lock_);
+		bool need = count_ < target_;
+		ReleaseSRWLockShared (&lock_);
+		if (!need || WAIT_OBJECT_0 == WaitForSingleObject (terminate_event_, 0))
+			break;
+		HANDLE h = create ();
+		if (!h)
+			break;
+		AcquireSRWLockExclusive (&lock_);
+		if (count_ < SECTION_POOL_MAX) {
+			stock_ [count_++] = h;
+			h = nullptr;
+		}
+		ReleaseSRWLockExclusive (&lock_);
+		if (h) {
+			CloseHandle (h);
+			break;
+		}
+	}
+}
+
+DWORD WINAPI SectionPool::s_thread_proc (void* _this)
+{
+	SectionPool* p = (SectionPool*)_this;
+	HANDLE wait_handles [2] = { p->terminate_event_, p->refill_event_ };
+	ULONGLONG period_begin = GetTickCount64 ();
+	p->refill ();
+	// Nothing is taken and the target can not decay, so the thread sleeps until the next get ().
+	while (WAIT_OBJECT_0 != WaitForMultipleObjects (2, wait_handles, FALSE,
+		p->idle () ? INFINITE : SECTION_POOL_PERIOD)) {
+		ULONGLONG t = GetTickCount64 ();
+		if (t - period_begin >= SECTION_POOL_PERIOD) {
+			period_begin = t;
+			p->adapt ();
+		}
+		p->refill ();
+	}
+	return 0;
+}
+
+}
+}
+}
@@ -0,0 +1,91 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_SECTIONPOOL_H_
+#define NIRVANA_CORE_WINDOWS_SECTIONPOOL_H_
+#pragma once
+
+#include "win32.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Process-wide stock of the ready memory sections.
+/// 
+/// Creation of the pagefile-backed section is a heavyweight kernel call.
+/// The low-priority background thread creates the sections in advance,
+/// so the first commit and remap of a block just take a ready one.
+/// 
+/// The stock size follows the number of sections taken during the last
+/// SECTION_POOL_PERIOD: it grows at once and decays by half each period,
+/// but not below SECTION_POOL_MIN.
+/// When the stock is at the minimal target and nothing is taken, the thread sleeps until the next get ().
+class SectionPool
+{
+	SectionPool (const SectionPool&) = delete;
+	SectionPool& operator = (const SectionPool&) = delete;
+
+public:
+	SectionPool () noexcept;
+	~SectionPool ();
+
+	/// Start the background thread.
+	bool initialize () noexcept;
+
+	/// Get a ready section from the stock.
+	/// 
+	/// \returns The section handle or nullptr if the stock is empty.
+	HANDLE get () noexcept;
+
+	/// Create a new section.
+	/// 
+	/// \returns The section handle or nullptr on failure.
+	static HANDLE create () noexcept;
+
+private:
+	static DWORD WINAPI s_thread_proc (void* _this);
+
+	void adapt () noexcept;
+	bool idle () noexcept;
+	void refill () noexcept;
+
+private:
+	SRWLOCK lock_;
+	HANDLE terminate_event_;
+	HANDLE refill_event_;
+	HANDLE thread_;
+	unsigned count_;
+	unsigned target_;
+	unsigned taken_; // Sections taken during the current period
+	HANDLE stock_ [SECTION_POOL_MAX];
+};
+
+}
+}
+}
+
+#endif
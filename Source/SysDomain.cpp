@@ -28,6 +28,7 @@
 #include "win32.h"
 #include "WinWChar.h"
 #include "error2errno.h"
+#include "SchedulerMaster.h"
 #include <Nirvana/string_conv.h>
 
 namespace Nirvana {
@@ -36,6 +37,12 @@ using namespace Windows;
 namespace Port {
 
 uint32_t SysDomain::create_prot_domain (unsigned platform, const IDL::String& host, unsigned port)
+{
+	return create_prot_domain (platform, host, port, DOMAIN_CORE_QUOTA, DOMAIN_CORE_WEIGHT);
+}
+
+uint32_t SysDomain::create_prot_domain (unsigned platform, const IDL::String& host, unsigned port,
+	unsigned core_quota, unsigned core_weight)
 {
 	WinWChar path [MAX_PATH + 1];
 	DWORD cc = GetModuleFileNameW (nullptr, path, (DWORD)std::size (path));
@@ -77,18 +84,32 @@ uint32_t SysDomain::create_prot_domain (unsigned platform, const IDL::String& ho
 	STARTUPINFOW si;
 	zero (si);
 	PROCESS_INFORMATION pi;
+	// The process is created suspended, so the budget is set before it connects to the scheduler.
 	if (!CreateProcessW (path, const_cast <WinWChar*> (cmd_line.data ()), nullptr, nullptr, false,
-		DETACHED_PROCESS | PROCESS_PRIORITY_CLASS,
+		DETACHED_PROCESS | PROCESS_PRIORITY_CLASS | CREATE_SUSPENDED,
 		nullptr, dir.c_str (), &si, &pi))
 		throw_last_error ();
 
+	SchedulerMaster& scheduler = SchedulerMaster::singleton ();
+	try {
+		scheduler.domain_budget (pi.dwProcessId, core_quota, core_weight);
+	} catch (...) {
+		TerminateProcess (pi.hProcess, -1);
+		CloseHandle (pi.hThread);
+		CloseHandle (pi.hProcess);
+		throw;
+	}
+	ResumeThread (pi.hThread);
 	CloseHandle (pi.hThread);
 
 	StartingProcess proc;
 	starting_map_.emplace (pi.dwProcessId, &proc);
 	proc.timer_event.wait ();
-	if (!proc.started)
+	if (!proc.started) {
 		TerminateProcess (pi.hProcess, -1);
+		unsigned quota, weight;
+		scheduler.take_domain_budget (pi.dwProcessId, quota, weight);
+	}
 	CloseHandle (pi.hProcess);
 
 	if (!proc.started)
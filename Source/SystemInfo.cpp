@@ -26,6 +26,7 @@
 #include "../Port/SystemInfo.h"
 #include "../pe/PortableExecutable.h"
 #include "win32.h"
+#include "SystemTopology.h"
 
 namespace Nirvana {
 namespace Core {
@@ -58,7 +59,11 @@ bool SystemInfo::initialize () noexcept
 	if ((uintptr_t)si.lpMaximumApplicationAddress & (~(uintptr_t)0 << ADDRESS_BITS_USED))
 		return false;
 	base_address_ = GetModuleHandleW (nullptr);
-	hardware_concurrency_ = si.dwNumberOfProcessors;
+	// dwNumberOfProcessors is limited by the current processor group.
+	// Use all logical processors from the topology, except for the reserved ones.
+	if (!Windows::SystemTopology::initialize ())
+		return false;
+	hardware_concurrency_ = Windows::SystemTopology::placement ().count ();
 	return true;
 }
 
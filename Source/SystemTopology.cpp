@@ -0,0 +1,137 @@
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "SystemTopology.h"
+#include "win32.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+TopologyModel SystemTopology::model_;
+Placement SystemTopology::placement_;
+unsigned SystemTopology::group_base_ [MAX_GROUPS];
+
+bool SystemTopology::initialize () noexcept
+{
+	model_.clear ();
+
+	DWORD cb = 0;
+	GetLogicalProcessorInformationEx (RelationAll, nullptr, &cb);
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = nullptr;
+	if (cb && (info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)HeapAlloc (GetProcessHeap (), 0, cb))) {
+		if (GetLogicalProcessorInformationEx (RelationAll, info, &cb)) {
+			const BYTE* end = (const BYTE*)info + cb;
+
+			// Each core record lists the SMT siblings of one physical core.
+			uint32_t core = 0;
+			for (const BYTE* p = (const BYTE*)info; p < end;
+				p += ((const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)p)->Size) {
+				const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* rel = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)p;
+				if (RelationProcessorCore != rel->Relationship)
+					continue;
+
+				for (WORD g = 0; g < rel->Processor.GroupCount; ++g) {
+					const GROUP_AFFINITY& ga = rel->Processor.GroupMask [g];
+					for (unsigned bit = 0; bit < sizeof (KAFFINITY) * 8; ++bit) {
+						if (!(ga.Mask & ((KAFFINITY)1 << bit)))
+							continue;
+						// Find the NUMA node of the logical processor.
+						unsigned node = 0;
+						for (const BYTE* n = (const BYTE*)info; n < end; n += ((const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)n)->Size) {
+							const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* nr = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)n;
+							if (RelationNumaNode == nr->Relationship && nr->NumaNode.GroupMask.Group == ga.Group
+								&& (nr->NumaNode.GroupMask.Mask & ((KAFFINITY)1 << bit))) {
+								node = nr->NumaNode.NodeNumber;
+								break;
+							}
+						}
+						model_.add (ga.Group, (uint8_t)bit, node, core);
+					}
+				}
+				++core;
+			}
+		}
+		HeapFree (GetProcessHeap (), 0, info);
+	}
+
+	if (!model_.processor_count ()) {
+		// Fallback: current processor group, one node, no SMT information.
+		::SYSTEM_INFO si;
+		::GetSystemInfo (&si);
+		for (unsigned i = 0; i < si.dwNumberOfProcessors && i < sizeof (KAFFINITY) * 8; ++i) {
+			model_.add (0, (uint8_t)i, 0, i);
+		}
+	}
+
+	if (!model_.processor_count ())
+		return false;
+
+	// The processors of a group are numbered after the processors of the previous groups.
+	unsigned group_size [MAX_GROUPS] = { 0 };
+	for (unsigned i = 0, cnt = model_.processor_count (); i < cnt; ++i) {
+		const LogicalProcessor& p = model_.processor (i);
+		if (p.group < MAX_GROUPS && group_size [p.group] <= p.number)
+			group_size [p.group] = p.number + 1u;
+	}
+	unsigned base = 0;
+	for (unsigned g = 0; g < MAX_GROUPS; ++g) {
+		group_base_ [g] = base;
+		base += group_size [g];
+	}
+
+	placement_.build (model_, RESERVED_RECEPTION_CORES);
+	return true;
+}
+
+bool SystemTopology::affinity (void* thread, unsigned processor) noexcept
+{
+	// The thread is bound to the NUMA node of the processor in its group.
+	// The processor itself is only ideal, so the system balances the threads of all
+	// protection domains, which have the same placement, within the node.
+	const LogicalProcessor& p = model_.processor (processor);
+	GROUP_AFFINITY ga;
+	ZeroMemory (&ga, sizeof (ga));
+	ga.Group = p.group;
+	for (unsigned i = 0, cnt = model_.processor_count (); i < cnt; ++i) {
+		const LogicalProcessor& lp = model_.processor (i);
+		if (lp.group == p.group && lp.node == p.node)
+			ga.Mask |= (KAFFINITY)1 << lp.number;
+	}
+
+	// The node mask may be out of the process affinity, for example, in a job.
+	// Then the thread stays in the default group and only the ideal processor is set.
+	bool bound = SetThreadGroupAffinity (thread, &ga, nullptr);
+
+	PROCESSOR_NUMBER pn;
+	pn.Group = p.group;
+	pn.Number = p.number;
+	pn.Reserved = 0;
+	return SetThreadIdealProcessorEx (thread, &pn, nullptr) || bound;
+}
+
+}
+}
+}
@@ -0,0 +1,82 @@
+/// \file
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_SYSTEMTOPOLOGY_H_
+#define NIRVANA_CORE_WINDOWS_SYSTEMTOPOLOGY_H_
+#pragma once
+
+#include "Topology.h"
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Processor topology of the current system.
+class SystemTopology
+{
+public:
+	/// Discover processor groups, NUMA nodes and SMT siblings.
+	/// Called from SystemInfo::initialize ().
+	static bool initialize () noexcept;
+
+	static const Topology& topology () noexcept
+	{
+		return model_;
+	}
+
+	/// Thread pool placement.
+	/// The reserved cores, if any, are excluded from the worker placement.
+	static const Placement& placement () noexcept
+	{
+		return placement_;
+	}
+
+	/// Bind thread to the NUMA node of the logical processor and make the processor ideal.
+	/// 
+	/// \param thread Thread handle.
+	/// \param processor Processor index in the topology.
+	/// \returns `false` if neither the affinity nor the ideal processor was set.
+	static bool affinity (void* thread, unsigned processor) noexcept;
+
+	/// \returns Sequential number of the logical processor over all processor groups.
+	static unsigned sequential_number (unsigned group, unsigned number) noexcept
+	{
+		return (group < MAX_GROUPS ? group_base_ [group] : 0) + number;
+	}
+
+private:
+	static const unsigned MAX_GROUPS = 32;
+
+	static TopologyModel model_;
+	static Placement placement_;
+	static unsigned group_base_ [MAX_GROUPS];
+};
+
+}
+}
+}
+
+#endif
@@ -26,23 +26,65 @@
 #include "Thread.inl"
 #include <Thread.h>
 #include "error2errno.h"
+#include "SystemTopology.h"
 
 namespace Nirvana {
 namespace Core {
 namespace Port {
 
 unsigned long Thread::current_;
+thread_local Thread::TokenId Thread::impersonated_;
 const int Thread::DEFAULT_PRIORITY_BOOST = Windows::THREAD_PRIORITY_MAX;
 
-void Thread::create (PTHREAD_START_ROUTINE thread_proc, void* param, int priority)
+// The impersonated token belongs to the system thread, not to the fiber.
+// impersonated_ is accessed only inside impersonate () and revert (), without the context switch,
+// so it always describes the token of the thread the fiber is currently running on.
+// The token is identified by TokenId that is unique until the system restart, unlike the handle value.
+// ModifiedId detects the changes of the token privileges and groups.
+
+static const uint64_t UNKNOWN_TOKEN = ~(uint64_t)0;
+
+void Thread::impersonate (const Security::Context& sec_context) noexcept
+{
+	if (sec_context.empty ())
+		revert ();
+	else {
+		TokenId id { UNKNOWN_TOKEN, 0 };
+		TOKEN_STATISTICS stat;
+		DWORD size;
+		if (GetTokenInformation (sec_context, TokenStatistics, &stat, sizeof (stat), &size)) {
+			id.id = (uint64_t)stat.TokenId.HighPart << 32 | stat.TokenId.LowPart;
+			id.modified = (uint64_t)stat.ModifiedId.HighPart << 32 | stat.ModifiedId.LowPart;
+		}
+		if (UNKNOWN_TOKEN == id.id || impersonated_.id != id.id || impersonated_.modified != id.modified) {
+			NIRVANA_VERIFY (ImpersonateLoggedOnUser (sec_context));
+			impersonated_ = id; // The unknown token never matches
+		}
+	}
+}
+
+void Thread::revert () noexcept
+{
+	if (impersonated_.id) {
+		NIRVANA_VERIFY (RevertToSelf ());
+		impersonated_.id = 0;
+	}
+}
+
+void Thread::create (PTHREAD_START_ROUTINE thread_proc, void* param, int priority, unsigned processor)
 {
 	assert (!handle_);
+	// The thread is placed before it starts.
 	handle_ = CreateThread (nullptr, Windows::NEUTRAL_FIBER_STACK_RESERVE, thread_proc, param,
-		STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr);
+		STACK_SIZE_PARAM_IS_A_RESERVATION | (ANY_PROCESSOR != processor ? CREATE_SUSPENDED : 0), nullptr);
 	if (!handle_)
 		throw_NO_MEMORY ();
 	if (THREAD_PRIORITY_NORMAL != priority)
 		NIRVANA_VERIFY (SetThreadPriority (handle_, priority));
+	if (ANY_PROCESSOR != processor) {
+		NIRVANA_VERIFY (Windows::SystemTopology::affinity (handle_, processor));
+		ResumeThread (handle_);
+	}
 }
 
 Thread::PriorityBoost::PriorityBoost (Core::Thread* thread, int priority) noexcept :
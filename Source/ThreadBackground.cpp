@@ -27,6 +27,7 @@
 #include <ThreadBackground.h>
 #include <ExecDomain.h>
 #include "Thread.inl"
+#include "../Port/SystemInfo.h"
 
 namespace Nirvana {
 namespace Core {
@@ -38,13 +39,14 @@ DWORD CALLBACK ThreadBackground::thread_proc (ThreadBackground* _this) noexcept
 	Port::Thread::current (&thread);
 	thread.neutral_context ().port ().convert_to_fiber ();
 
+	// Spinning is useless on the single processor.
+	Windows::WorkerGate::SpinPolicy policy (SystemInfo::hardware_concurrency () > 1 ? Windows::WORKER_SPIN_MAX : 0);
 	for (;;) {
-		DWORD ret = WaitForSingleObject (_this->event_, INFINITE);
-		assert (WAIT_OBJECT_0 == ret);
+		_this->event_.wait (policy);
 		if (_this->finish_)
 			break;
 		thread.run ();
-		RevertToSelf ();
+		Port::Thread::revert ();
 	}
 
 	// The object may be destructed here
@@ -56,16 +58,11 @@ DWORD CALLBACK ThreadBackground::thread_proc (ThreadBackground* _this) noexcept
 
 ThreadBackground::ThreadBackground () :
 	finish_ (false)
-{
-	if (!(event_ = CreateEventW (nullptr, false, false, nullptr)))
-		throw_NO_MEMORY ();
-}
+{}
 
 ThreadBackground::~ThreadBackground ()
 {
 	neutral_context ().port ().detach (); // Prevent DeleteFiber in ~ExecContext ()
-
-	CloseHandle (event_);
 }
 
 void ThreadBackground::start ()
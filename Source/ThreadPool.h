@@ -30,6 +30,7 @@
 
 #include <SharedAllocator.h>
 #include "../Port/SystemInfo.h"
+#include "SystemTopology.h"
 
 namespace Nirvana {
 namespace Core {
@@ -40,11 +41,13 @@ namespace Windows {
 /// \tparam Worker Thread class.
 /// Worker constructor gets reference to Master as parameter.
 /// Worker class must have method Worker::create(int priority);
+/// The worker objects are placed in the array aligned to alignof (Worker),
+/// so the worker class may be aligned to the cache line to avoid false sharing.
 template <class Master, class Worker>
 class ThreadPool :
 	public Master
 {
-	typedef SharedAllocator <Worker> Allocator;
+	typedef SharedAllocator <uint8_t> Allocator;
 
 public:
 	static unsigned int thread_count () noexcept
@@ -54,10 +57,12 @@ public:
 
 	ThreadPool () :
 		Master (),
-		threads_ (nullptr)
+		threads_ (nullptr),
+		block_ (nullptr)
 	{
 		Allocator allocator;
-		threads_ = allocator.allocate (thread_count ());
+		block_ = allocator.allocate (block_size ());
+		threads_ = (Worker*)(((uintptr_t)block_ + alignof (Worker) - 1) & ~(uintptr_t)(alignof (Worker) - 1));
 		Worker* p = threads_;
 		try {
 			for (Worker* end = p + thread_count (); p != end; ++p) {
@@ -67,7 +72,7 @@ public:
 			while (p != threads_) {
 				(--p)->~Worker ();
 			}
-			allocator.deallocate (threads_, thread_count ());
+			allocator.deallocate (block_, block_size ());
 			throw;
 		}
 	}
@@ -78,7 +83,7 @@ public:
 		for (Worker* p = threads_, *end = p + thread_count (); p != end; ++p) {
 			p->~Worker ();
 		}
-		allocator.deallocate (threads_, thread_count ());
+		allocator.deallocate (block_, block_size ());
 	}
 
 	Worker* threads () noexcept
@@ -87,19 +92,29 @@ public:
 	}
 
 	//! Create and start threads.
+	//! Threads are spread over the processor groups and NUMA nodes
+	//! or prefer the cores reserved for the reception threads.
 	void start (int priority)
 	{
 		Master::start ();
+		const Placement& placement = SystemTopology::placement ();
 		for (Worker* p = threads_, *end = p + thread_count (); p != end; ++p) {
-			p->create (p, priority);
+			p->create (p, priority, placement.reception ((unsigned)(p - threads_)));
 		}
 	}
 
 	//! Terminate threads.
 	void terminate () noexcept;
 
+private:
+	static size_t block_size () noexcept
+	{
+		return sizeof (Worker) * thread_count () + alignof (Worker) - 1;
+	}
+
 private:
 	Worker* threads_;
+	uint8_t* block_;
 };
 
 template <class Master, class Worker>
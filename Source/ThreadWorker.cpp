@@ -41,6 +41,7 @@ unsigned long __stdcall ThreadWorker::thread_proc (ThreadWorker* _this)
 	Port::Thread::current (&thread);
 	thread.neutral_context ().port ().convert_to_fiber ();
 	SchedulerBase::singleton ().worker_thread_proc ();
+	Port::Thread::revert ();
 	Port::ExecContext::convert_to_thread ();
 	thread.neutral_context ().port ().detach (); // Prevent DeleteFiber in ~ExecContext ()
 	return 0;
@@ -65,6 +66,7 @@ void CALLBACK ThreadWorker::main_neutral_fiber_proc (MainNeutralFiberParam* para
 	for (ThreadWorker* t = param->other_workers, *end = t + param->other_worker_cnt; t != end; ++t) {
 		t->join ();
 	}
+	Port::Thread::revert ();
 	// Switch back to main fiber.
 	SwitchToFiber (Port::ExecContext::main_fiber ());
 }
@@ -95,6 +97,11 @@ void ThreadWorker::run_main (Startup& startup, DeadlineTime deadline, ThreadWork
 	int prio = GetThreadPriority (GetCurrentThread ());
 	SetThreadPriority (GetCurrentThread (), Windows::WORKER_THREAD_PRIORITY);
 
+	// Bind main thread to the first processor of the placement
+	GROUP_AFFINITY affinity;
+	bool restore_affinity = GetThreadGroupAffinity (GetCurrentThread (), &affinity);
+	SystemTopology::affinity (GetCurrentThread (), SystemTopology::placement ().processor (0));
+
 	// Switch to neutral context and run main_neutral_fiber_proc
 	SwitchToFiber (worker_fiber);
 
@@ -108,8 +115,10 @@ void ThreadWorker::run_main (Startup& startup, DeadlineTime deadline, ThreadWork
 	Port::Thread::current (nullptr);
 	Port::ExecContext::current (nullptr);
 
-	// Restore priority and release resources
+	// Restore priority, affinity and release resources
 	SetThreadPriority (GetCurrentThread (), prio);
+	if (restore_affinity)
+		SetThreadGroupAffinity (GetCurrentThread (), &affinity, nullptr);
 }
 
 }
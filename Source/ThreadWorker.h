@@ -42,13 +42,16 @@ class WorkerSemaphore;
 class CompletionPort;
 
 /// Platform-specific worker thread implementation.
-class ThreadWorker final :
+/// Worker objects are allocated in array and the thread state is written on each
+/// executor switch. The cache line alignment avoids false sharing between the workers.
+class alignas (64) ThreadWorker final :
 	public Core::ThreadWorker
 {
 public:
-	void create ()
+	/// \param processor Index of the logical processor in the system topology.
+	void create (unsigned processor)
 	{
-		port ().create (this, WORKER_THREAD_PRIORITY);
+		port ().create (this, WORKER_THREAD_PRIORITY, processor);
 	}
 
 	void run_main (Startup& startup, DeadlineTime deadline, ThreadWorker* other_workers, size_t other_worker_cnt);
@@ -62,10 +65,13 @@ public:
 	~ThreadWorker ()
 	{}
 
+	/// The impersonation is kept after the executor.
+	/// Each executor impersonates own security context when it starts running,
+	/// so Port::Thread::impersonate skips the system calls if the token is the same
+	/// and reverts if the context is empty. The worker reverts before it parks.
 	void execute (Ref <Executor>&& executor) noexcept
 	{
 		static_cast <Core::ThreadWorker&> (*this).execute (std::move (executor));
-		RevertToSelf ();
 	}
 
 	void join ()
@@ -73,6 +79,15 @@ public:
 		Port::Thread::join ();
 	}
 
+	/// Start the thread again after the previous thread of this object exited.
+	void restart ()
+	{
+		join ();
+		CloseHandle (handle_);
+		handle_ = nullptr;
+		create (Port::Thread::ANY_PROCESSOR);
+	}
+
 private:
 	friend class Port::Thread;
 	static unsigned long __stdcall thread_proc (ThreadWorker* _this);
@@ -24,6 +24,7 @@
 *  popov.nirvana@gmail.com
 */
 #include "Timer.h"
+#include "SystemTopology.h"
 #include <Timer.h>
 #include <timeapi.h>
 
@@ -39,7 +40,8 @@ public:
 		pool_ (TIMER_POOL_MIN),
 		terminate_ (CreateEventW (nullptr, true, false, nullptr)),
 		inactive_ (CreateEventW (nullptr, true, true, nullptr)),
-		active_timer_count_ (0)
+		active_timer_count_ (0),
+		created_ (0)
 	{
 		TIMECAPS tc;
 		timeGetDevCaps (&tc, sizeof (tc));
@@ -101,12 +103,22 @@ public:
 		return min_period_;
 	}
 
+	/// \returns The reserved processor for the new timer thread or ANY_PROCESSOR.
+	unsigned processor () noexcept
+	{
+		const Placement& placement = SystemTopology::placement ();
+		if (placement.reserved_count ())
+			return placement.reception (created_.fetch_add (1, std::memory_order_relaxed));
+		return Thread::ANY_PROCESSOR;
+	}
+
 private:
 	ObjectPool <Timer*> pool_;
 	HANDLE terminate_;
 	HANDLE inactive_;
 	AtomicCounter <false> active_timer_count_;
 	UINT min_period_;
+	std::atomic <unsigned> created_;
 };
 
 StaticallyAllocated <Timer::Global> Timer::global_;
@@ -130,7 +142,7 @@ inline Timer::Timer () :
 		Windows::throw_last_error ();
 	handles_ [HANDLE_TERMINATE] = global_->terminate_event ();
 
-	Thread::create (this, Windows::TIMER_THREAD_PRIORITY);
+	Thread::create (this, Windows::TIMER_THREAD_PRIORITY, global_->processor ());
 }
 
 Timer::~Timer ()
@@ -0,0 +1,286 @@
+/// \file
+/// Processor topology model and thread placement.
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_TOPOLOGY_H_
+#define NIRVANA_CORE_WINDOWS_TOPOLOGY_H_
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Logical processor location.
+struct LogicalProcessor
+{
+	uint16_t group;  ///< Processor group
+	uint8_t number;  ///< Processor number in the group
+	uint16_t node;   ///< NUMA node index in the topology, 0 .. node_count () - 1
+	uint32_t core;   ///< Physical core. SMT siblings have the same core.
+};
+
+/// Processor topology interface.
+/// 
+/// The placement logic depends only on this interface,
+/// so it can be tested with synthetic topologies on any host.
+class Topology
+{
+public:
+	/// Maximal number of the logical processors supported.
+	static const unsigned MAX_PROCESSORS = 1024;
+
+	virtual unsigned processor_count () const noexcept = 0;
+	virtual const LogicalProcessor& processor (unsigned i) const noexcept = 0;
+	virtual unsigned node_count () const noexcept = 0;
+
+	/// \returns The system NUMA node number for the node index.
+	virtual unsigned node_number (unsigned node) const noexcept = 0;
+
+protected:
+	~Topology ()
+	{}
+};
+
+/// Topology stored in the fixed size arrays.
+/// Does not allocate memory, so it can be filled before the heap initialization.
+class TopologyModel : public Topology
+{
+public:
+	TopologyModel () noexcept :
+		processor_count_ (0),
+		node_count_ (0)
+	{}
+
+	virtual unsigned processor_count () const noexcept override
+	{
+		return processor_count_;
+	}
+
+	virtual const LogicalProcessor& processor (unsigned i) const noexcept override
+	{
+		assert (i < processor_count_);
+		return processors_ [i];
+	}
+
+	virtual unsigned node_count () const noexcept override
+	{
+		return node_count_;
+	}
+
+	virtual unsigned node_number (unsigned node) const noexcept override
+	{
+		assert (node < node_count_);
+		return node_numbers_ [node];
+	}
+
+	/// Add logical processor.
+	/// 
+	/// \param node_number System NUMA node number.
+	/// \returns `false` if the maximal number of processors is reached.
+	bool add (uint16_t group, uint8_t number, unsigned node_number, uint32_t core) noexcept
+	{
+		if (processor_count_ >= MAX_PROCESSORS)
+			return false;
+		unsigned node = 0;
+		while (node < node_count_ && node_numbers_ [node] != node_number)
+			++node;
+		if (node == node_count_)
+			node_numbers_ [node_count_++] = node_number;
+		LogicalProcessor& p = processors_ [processor_count_++];
+		p.group = group;
+		p.number = number;
+		p.node = (uint16_t)node;
+		p.core = core;
+		return true;
+	}
+
+	void clear () noexcept
+	{
+		processor_count_ = 0;
+		node_count_ = 0;
+	}
+
+private:
+	unsigned processor_count_;
+	unsigned node_count_;
+	LogicalProcessor processors_ [MAX_PROCESSORS];
+	unsigned node_numbers_ [MAX_PROCESSORS];
+};
+
+/// Order of the processors for a thread pool.
+/// 
+/// Threads are spread over the NUMA nodes round-robin.
+/// Within the node, one logical processor of each physical core is used
+/// before the SMT siblings.
+/// 
+/// Optionally, some physical cores with all their SMT siblings are reserved for
+/// the message reception threads and excluded from the worker placement.
+class Placement
+{
+public:
+	Placement () noexcept :
+		topology_ (nullptr),
+		count_ (0),
+		reserved_count_ (0)
+	{}
+
+	/// \param reserved_cores Number of the physical cores reserved for the reception threads.
+	///   The reservation is ignored if no cores remain for the workers.
+	Placement (const Topology& topology, unsigned reserved_cores = 0) noexcept
+	{
+		build (topology, reserved_cores);
+	}
+
+	void build (const Topology& topology, unsigned reserved_cores = 0) noexcept
+	{
+		topology_ = &topology;
+		count_ = topology.processor_count ();
+		reserved_count_ = 0;
+
+		// Rank of each processor among its SMT siblings.
+		static_assert (Topology::MAX_PROCESSORS <= 0xFFFF, "MAX_PROCESSORS");
+		uint16_t rank [Topology::MAX_PROCESSORS];
+		for (unsigned i = 0; i < count_; ++i) {
+			const LogicalProcessor& p = topology.processor (i);
+			uint16_t r = 0;
+			for (unsigned j = 0; j < i; ++j) {
+				const LogicalProcessor& s = topology.processor (j);
+				if (s.core == p.core && s.node == p.node)
+					++r;
+			}
+			rank [i] = r;
+		}
+
+		// Sort by (rank, original order) inside each node and interleave the nodes.
+		bool used [Topology::MAX_PROCESSORS] = { false };
+		unsigned nodes = topology.node_count ();
+		unsigned out = 0;
+		while (out < count_) {
+			for (unsigned node = 0; node < nodes && out < count_; ++node) {
+				unsigned best = count_;
+				for (unsigned i = 0; i < count_; ++i) {
+					if (!used [i] && topology.processor (i).node == node
+						&& (best == count_ || rank [i] < rank [best]))
+						best = i;
+				}
+				if (best < count_) {
+					used [best] = true;
+					order_ [out++] = (uint16_t)best;
+				}
+			}
+		}
+
+		unsigned cores = 0;
+		for (unsigned i = 0; i < count_; ++i) {
+			if (!rank [i])
+				++cores;
+		}
+		if (reserved_cores && reserved_cores < cores)
+			reserve (rank, reserved_cores);
+	}
+
+	/// \returns Number of the logical processors for the workers.
+	unsigned count () const noexcept
+	{
+		return count_;
+	}
+
+	/// \returns Processor index in the topology for the thread.
+	unsigned processor (unsigned thread) const noexcept
+	{
+		assert (count_);
+		return order_ [thread % count_];
+	}
+
+	/// \returns The NUMA node index for the thread.
+	unsigned node (unsigned thread) const noexcept
+	{
+		return count_ ? topology_->processor (processor (thread)).node : 0;
+	}
+
+	/// \returns Number of the logical processors reserved for the reception threads.
+	unsigned reserved_count () const noexcept
+	{
+		return reserved_count_;
+	}
+
+	/// \returns Processor index in the topology for the reception thread.
+	///   If there is no reservation, the reception threads share the processors with the workers.
+	unsigned reception (unsigned thread) const noexcept
+	{
+		if (reserved_count_)
+			return reserved_ [thread % reserved_count_];
+		return processor (thread);
+	}
+
+private:
+	// Move the cores of the last first-rank processors to the reserved list.
+	// The last ones in the order are used by the workers least.
+	void reserve (const uint16_t* rank, unsigned reserved_cores) noexcept
+	{
+		uint32_t cores [Topology::MAX_PROCESSORS];
+		unsigned core_cnt = 0;
+		for (unsigned i = count_; i > 0 && core_cnt < reserved_cores;) {
+			unsigned p = order_ [--i];
+			if (!rank [p])
+				cores [core_cnt++] = topology_->processor (p).core;
+		}
+
+		unsigned out = 0;
+		for (unsigned i = 0; i < count_; ++i) {
+			unsigned p = order_ [i];
+			uint32_t core = topology_->processor (p).core;
+			bool reserved = false;
+			for (unsigned c = 0; c < core_cnt; ++c) {
+				if (cores [c] == core) {
+					reserved = true;
+					break;
+				}
+			}
+			if (reserved)
+				reserved_ [reserved_count_++] = (uint16_t)p;
+			else
+				order_ [out++] = (uint16_t)p;
+		}
+		count_ = out;
+	}
+
+private:
+	const Topology* topology_;
+	unsigned count_;
+	unsigned reserved_count_;
+	uint16_t order_ [Topology::MAX_PROCESSORS];
+	uint16_t reserved_ [Topology::MAX_PROCESSORS];
+};
+
+}
+}
+}
+
+#endif
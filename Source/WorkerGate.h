@@ -0,0 +1,184 @@
+/// \file
+/// Spin-then-park gate for the slave worker threads.
+/*
+* Nirvana Core. Windows port library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CORE_WINDOWS_WORKERGATE_H_
+#define NIRVANA_CORE_WINDOWS_WORKERGATE_H_
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#if defined (_M_IX86) || defined (_M_X64) || defined (__i386__) || defined (__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace Nirvana {
+namespace Core {
+namespace Windows {
+
+/// Counter of the granted cores, placed in the memory shared by the master and the domain.
+/// 
+/// The master grants a core by the counter increment. The kernel semaphore is released only
+/// if a worker thread is blocked on it. Idle worker threads spin on the counter for a while
+/// before blocking on the semaphore.
+/// 
+/// The gate does not depend on Windows API and can be tested on any host.
+class WorkerGate
+{
+public:
+	/// Shared memory layout.
+	struct Shared
+	{
+		/// Number of granted cores minus number of blocked worker threads.
+		std::atomic <int32_t> count;
+		uint8_t padding [64 - sizeof (std::atomic <int32_t>)];
+	};
+
+	/// Adaptive spin budget. One per worker thread.
+	/// 
+	/// Keeps the moving average of the recent wake intervals. If the intervals are short,
+	/// the thread spins about twice the average before parking. If they are longer than
+	/// the maximal spin time, spinning is useless and the thread parks immediately.
+	class SpinPolicy
+	{
+	public:
+		/// \param max_ns Maximal spin time in nanoseconds. 0 disables spinning.
+		SpinPolicy (uint32_t max_ns) noexcept :
+			max_ (max_ns),
+			avg_ (max_ns)
+		{}
+
+		/// Spin time for the next idle period in nanoseconds.
+		uint32_t budget () const noexcept
+		{
+			if (avg_ > max_)
+				return 0;
+			uint64_t b = avg_ * 2;
+			return b < max_ ? (uint32_t)b : max_;
+		}
+
+		/// The thread got the work after the idle period.
+		void woken (uint64_t interval_ns) noexcept
+		{
+			// Limit the interval, so the long idle does not disable spinning for too long.
+			uint64_t limit = (uint64_t)max_ * 16;
+			if (interval_ns > limit)
+				interval_ns = limit;
+			avg_ = (avg_ * 7 + interval_ns) / 8;
+		}
+
+	private:
+		uint32_t max_;
+		uint64_t avg_;
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	WorkerGate () noexcept :
+		shared_ (nullptr)
+	{}
+
+	/// Initialize the zero-filled shared memory.
+	void create (void* mem) noexcept
+	{
+		shared_ = (Shared*)mem;
+		shared_->count.store (0, std::memory_order_release);
+	}
+
+	void attach (void* mem) noexcept
+	{
+		shared_ = (Shared*)mem;
+	}
+
+	bool is_attached () const noexcept
+	{
+		return shared_ != nullptr;
+	}
+
+	/// Grant a core. Called by the master.
+	/// 
+	/// \returns `true` if a worker thread is blocked and the semaphore must be released.
+	bool release () noexcept
+	{
+		return shared_->count.fetch_add (1, std::memory_order_release) < 0;
+	}
+
+	/// Wait for a grant. Called by the idle worker thread.
+	/// 
+	/// \param policy Spin policy of the current thread.
+	/// \param stop Spinning is stopped if this flag is set.
+	/// \returns `true` if the grant is obtained. `false` if the thread must block on the semaphore.
+	///   In the last case the grant is already reserved for this thread and will be
+	///   delivered by the semaphore.
+	bool acquire (const SpinPolicy& policy, const std::atomic <bool>& stop) noexcept
+	{
+		uint32_t budget = policy.budget ();
+		if (budget) {
+			Clock::time_point end = Clock::now () + std::chrono::nanoseconds (budget);
+			do {
+				for (unsigned i = 0; i < SPIN_CHECK; ++i) {
+					if (try_acquire ())
+						return true;
+					pause ();
+				}
+			} while (!stop.load (std::memory_order_relaxed) && Clock::now () < end);
+		}
+		return shared_->count.fetch_sub (1, std::memory_order_acquire) > 0;
+	}
+
+	/// Try to get a grant without blocking.
+	bool try_acquire () noexcept
+	{
+		int32_t cnt = shared_->count.load (std::memory_order_relaxed);
+		while (cnt > 0) {
+			if (shared_->count.compare_exchange_weak (cnt, cnt - 1, std::memory_order_acquire))
+				return true;
+		}
+		return false;
+	}
+
+private:
+	/// Number of the counter checks between the clock reads.
+	static const unsigned SPIN_CHECK = 64;
+
+	static void pause () noexcept
+	{
+#if defined (_M_IX86) || defined (_M_X64) || defined (__i386__) || defined (__x86_64__)
+		_mm_pause ();
+#endif
+	}
+
+private:
+	Shared* shared_;
+};
+
+}
+}
+}
+
+#endif
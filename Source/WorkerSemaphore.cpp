@@ -30,11 +30,26 @@ namespace Nirvana {
 namespace Core {
 namespace Windows {
 
-void WorkerSemaphore::thread_proc (SchedulerSlave& scheduler)
+bool WorkerSemaphore::thread_proc (SchedulerSlave& scheduler, DWORD timeout)
 {
-	while (WaitForMultipleObjects ((DWORD)countof (handles_), handles_, FALSE, INFINITE) == WAIT_OBJECT_0) {
+	// Spinning is useless on the single processor.
+	WorkerGate::SpinPolicy policy (Port::SystemInfo::hardware_concurrency () > 1 ? WORKER_SPIN_MAX : 0);
+	for (;;) {
+		WorkerGate::Clock::time_point idle = WorkerGate::Clock::now ();
+		if (!gate_.acquire (policy, stop_)) {
+			// Do not keep the impersonation while parked.
+			Port::Thread::revert ();
+			DWORD ret = WaitForMultipleObjects ((DWORD)countof (handles_), handles_, FALSE, timeout);
+			if (WAIT_TIMEOUT == ret)
+				return true;
+			if (ret != WAIT_OBJECT_0)
+				break;
+		}
+		policy.woken (std::chrono::duration_cast <std::chrono::nanoseconds> (
+			WorkerGate::Clock::now () - idle).count ());
 		scheduler.execute ();
 	}
+	return false;
 }
 
 }
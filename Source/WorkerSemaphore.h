@@ -30,6 +30,7 @@
 
 #include "../Port/SystemInfo.h"
 #include "win32.h"
+#include "WorkerGate.h"
 
 namespace Nirvana {
 namespace Core {
@@ -42,12 +43,17 @@ class WorkerSemaphore
 public:
 	static unsigned int thread_count ()
 	{
-		return Port::SystemInfo::hardware_concurrency ();
+		return Port::SystemInfo::hardware_concurrency () + BLOCKING_SPARE_WORKERS_MAX;
 	}
 
-	void thread_proc (SchedulerSlave& scheduler);
+	/// Worker thread procedure.
+	/// 
+	/// \param timeout Idle time in milliseconds after which the procedure returns.
+	/// \returns `true` if the timeout expired, `false` on shutdown.
+	bool thread_proc (SchedulerSlave& scheduler, DWORD timeout = INFINITE);
 
-	WorkerSemaphore ()
+	WorkerSemaphore () :
+		stop_ (false)
 	{
 		handles_ [0] = nullptr;
 		NIRVANA_VERIFY (handles_ [1] = CreateEventW (nullptr, true, FALSE, nullptr));
@@ -69,6 +75,12 @@ public:
 		handles_ [WORKER_SEMAPHORE] = sem;
 	}
 
+	/// Set the shared gate memory.
+	void gate (void* mem)
+	{
+		gate_.create (mem);
+	}
+
 	HANDLE semaphore ()
 	{
 		assert (handles_ [WORKER_SEMAPHORE]);
@@ -78,11 +90,13 @@ public:
 	void start ()
 	{
 		assert (handles_ [WORKER_SEMAPHORE]);
+		stop_ = false;
 		ResetEvent (handles_ [SHUTDOWN_EVENT]);
 	}
 
 	void terminate () noexcept
 	{
+		stop_ = true;
 		SetEvent (handles_ [SHUTDOWN_EVENT]);
 	}
 
@@ -96,6 +110,8 @@ private:
 	};
 
 	HANDLE handles_ [HANDLE_COUNT];
+	WorkerGate gate_;
+	std::atomic <bool> stop_;
 };
 
 }
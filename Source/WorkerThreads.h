@@ -30,6 +30,9 @@
 
 #include "ThreadWorker.h"
 #include "ThreadPool.h"
+#include "../Port/SystemInfo.h"
+#include <atomic>
+#include <vector>
 
 namespace Nirvana {
 namespace Core {
@@ -38,20 +41,35 @@ class Startup;
 
 namespace Windows {
 
+/// Worker threads of the domain.
+/// 
+/// One worker thread per processor is started with the domain.
+/// The pool slots above the processor count are the spare threads for the blocking regions.
+/// A spare thread is started when a worker thread releases its core and there are less
+/// spare threads than the threads without a core. A spare thread exits when it was idle
+/// for BLOCKING_SPARE_RETIRE and the spare count exceeds the number of the threads without a core.
 template <class Master>
 class WorkerThreads :
 	public ThreadPool <Master, ThreadWorker>
 {
 	typedef ThreadPool <Master, ThreadWorker> Pool;
 public:
+	WorkerThreads () :
+		processors_ (Port::SystemInfo::hardware_concurrency ()),
+		released_ (0),
+		spares_ (0),
+		spare_state_ (Pool::thread_count () - processors_)
+	{}
+
 	void run (Startup& startup, DeadlineTime deadline)
 	{
 		Master::start ();
 
-		// Create other worker threads
-		for (ThreadWorker* p = Pool::threads () + 1,
-			*end = Pool::threads () + Pool::thread_count (); p != end; ++p) {
-			p->create ();
+		// Create other worker threads.
+		// The spare threads are created on demand.
+		const Placement& placement = SystemTopology::placement ();
+		for (ThreadWorker* p = Pool::threads () + 1, *end = Pool::threads () + processors_; p != end; ++p) {
+			p->create (placement.processor ((unsigned)(p - Pool::threads ())));
 		}
 
 		// Run main for the thread 0 (main thread).
@@ -62,6 +80,95 @@ public:
 	{
 		Master::terminate ();
 	}
+
+	/// A worker thread released its core in a blocking region.
+	/// 
+	/// \returns `true` if a spare thread was started.
+	bool core_released () noexcept
+	{
+		unsigned released = released_.fetch_add (1, std::memory_order_relaxed) + 1;
+		unsigned spares = spares_.load (std::memory_order_relaxed);
+		while (spares < released) {
+			if (spares_.compare_exchange_weak (spares, spares + 1, std::memory_order_relaxed)) {
+				if (start_spare ())
+					return true;
+				spares_.fetch_sub (1, std::memory_order_relaxed);
+				break;
+			}
+		}
+		return false;
+	}
+
+	/// The thread that released its core got a core again or completed the executor.
+	void core_returned () noexcept
+	{
+		released_.fetch_sub (1, std::memory_order_relaxed);
+	}
+
+	/// \returns `true` if the current thread is a spare thread.
+	bool is_spare () noexcept
+	{
+		const void* cur = Port::Thread::current (); // May be nullptr
+		return cur >= Pool::threads () + processors_ && cur < Pool::threads () + Pool::thread_count ();
+	}
+
+	/// Called by the spare thread that was idle for BLOCKING_SPARE_RETIRE.
+	/// 
+	/// \returns `true` if the thread must exit.
+	bool retire () noexcept
+	{
+		assert (is_spare ());
+		unsigned spares = spares_.load (std::memory_order_relaxed);
+		while (spares > released_.load (std::memory_order_relaxed)) {
+			if (spares_.compare_exchange_weak (spares, spares - 1, std::memory_order_relaxed)) {
+				// The slot may be restarted now, restart () waits for this thread to exit.
+				spare_state_ [spare_index ()].store (SPARE_EXITED, std::memory_order_release);
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	enum SpareState : uint8_t
+	{
+		SPARE_FREE,    ///< The thread was not created
+		SPARE_RUNNING,
+		SPARE_EXITED   ///< The thread exited, the handle is still open
+	};
+
+	size_t spare_index () noexcept
+	{
+		return (const ThreadWorker*)Port::Thread::current () - (Pool::threads () + processors_);
+	}
+
+	bool start_spare () noexcept
+	{
+		for (size_t i = 0; i < spare_state_.size (); ++i) {
+			std::atomic <uint8_t>& state = spare_state_ [i];
+			uint8_t s = state.load (std::memory_order_acquire);
+			if (SPARE_RUNNING != s && state.compare_exchange_strong (s, SPARE_RUNNING)) {
+				ThreadWorker& worker = Pool::threads () [processors_ + i];
+				try {
+					if (SPARE_EXITED == s)
+						worker.restart ();
+					else
+						worker.create (Port::Thread::ANY_PROCESSOR);
+					return true;
+				} catch (...) {
+					state.store (SPARE_FREE, std::memory_order_release);
+					return false;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	const unsigned processors_;
+	std::atomic <unsigned> released_; // Worker threads without a core
+	std::atomic <unsigned> spares_; // Running spare threads
+	std::vector <std::atomic <uint8_t> > spare_state_;
 };
 
 }
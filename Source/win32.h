@@ -89,6 +89,9 @@ const int TIMER_THREAD_PRIORITY = THREAD_PRIORITY_HIGHEST;
 /// Input/output thread priority
 const int IO_THREAD_PRIORITY = THREAD_PRIORITY_HIGHEST;
 
+/// Memory section pool refiller works when the system is idle.
+const int SECTION_POOL_THREAD_PRIORITY = THREAD_PRIORITY_BELOW_NORMAL;
+
 /// Maximal thread priority except for the scheduler
 const int THREAD_PRIORITY_MAX = THREAD_PRIORITY_HIGHEST;
 
@@ -110,6 +113,63 @@ const uint32_t PROCESS_PRIORITY_CLASS = HIGH_PRIORITY_CLASS;
 
 const unsigned TIMER_POOL_MIN = 8;
 
+/// Minimal number of free fibers in the execution context fiber pool.
+const unsigned FIBER_POOL_MIN = 8;
+
+/// Committed stack head of the pooled fiber.
+const size_t FIBER_STACK_COMMIT = 0x4000;
+
+/// Stack reserve of the pooled fiber for the user-mode context switch.
+/// CreateFiberEx uses the default reserve from the executable header.
+const size_t FIBER_STACK_RESERVE = 0x100000;
+
+/// Switch execution contexts with ContextSwitch instead of SwitchToFiber.
+/// The fiber local storage is not switched in this mode.
+/// Available on x64 and ARM64 only.
+/// The mode is incompatible with the CET shadow stacks, because the shadow stack is not switched.
+/// If the process runs with the user-mode shadow stack enabled, SwitchToFiber is used.
+const bool USER_MODE_CONTEXT_SWITCH = false;
+
+/// When the pooled fiber is reused, its committed stack above this size is trimmed
+/// back to FIBER_STACK_COMMIT below the current frame.
+const size_t FIBER_STACK_TRIM = 0x40000;
+
+/// Maximal time in nanoseconds the idle worker thread spins before blocking on the semaphore.
+/// The actual spin time adapts to the recent wake intervals. 0 disables spinning.
+const uint32_t WORKER_SPIN_MAX = 50000;
+
+/// Maximal number of the spare worker threads in each domain.
+/// When a worker thread blocks in a BlockingRegion, its core is released and may be used
+/// by a spare thread. The spare threads are started on demand, one per blocked thread.
+/// At the end of the region the thread waits until the scheduler grants a core again.
+const unsigned BLOCKING_SPARE_WORKERS_MAX = 64;
+
+/// Idle time in milliseconds after which a spare worker thread exits if it is not needed.
+const DWORD BLOCKING_SPARE_RETIRE = 10000;
+
+/// Number of the physical cores reserved for the postman and timer threads.
+/// The worker threads of all domains do not use the reserved cores with their SMT siblings,
+/// so the scheduling messages are received without delay when the system is fully loaded.
+/// 0 - no reservation, the reception threads share the cores with the workers.
+const unsigned RESERVED_RECEPTION_CORES = 0;
+
+/// Minimal number of the ready memory sections in the SectionPool stock.
+const unsigned SECTION_POOL_MIN = 4;
+
+/// Maximal number of the ready memory sections in the SectionPool stock.
+const unsigned SECTION_POOL_MAX = 256;
+
+/// SectionPool adaptation period in milliseconds.
+const DWORD SECTION_POOL_PERIOD = 100;
+
+/// Default maximal number of cores a protection domain may use when other domains wait.
+/// 0 - unlimited. See CoreBudget.h.
+/// A domain may be created with own budget, see Port::SysDomain::create_prot_domain.
+const unsigned DOMAIN_CORE_QUOTA = 0;
+
+/// Default share weight of a protection domain. 0 - no share limit.
+const unsigned DOMAIN_CORE_WEIGHT = 0;
+
 }
 }
 }
@@ -0,0 +1,16 @@
+// Minimal Nirvana base definitions for the host builds of the portable tests.
+// Used with the -ITest/Host option instead of the Nirvana SDK headers.
+#ifndef NIRVANA_NIRVANABASE_H_
+#define NIRVANA_NIRVANABASE_H_
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Nirvana {
+
+typedef uint64_t DeadlineTime;
+
+}
+
+#endif
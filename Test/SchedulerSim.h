@@ -0,0 +1,712 @@
+// Deterministic scheduler simulator. Does not depend on Windows API.
+//
+// Models the master scheduler (SchedulerImpl), the master side domain accounting (SchedulerProcess)
+// and the protection domain scheduler (SchedulerSlave) with the simulated cores and the virtual clock.
+// The scheduler protocol is not reimplemented: records are built with SchedulerDeferral,
+// transferred with SchedulerMessage and SchedulerRing, and dispatched with SchedulerDispatch
+// exactly as SchedulerSlave and SchedulerProcess do. The domain queue is LocalQueues.
+//
+// Build on the host with -ITest/Host.
+#ifndef SCHEDULERSIM_H_
+#define SCHEDULERSIM_H_
+#pragma once
+
+#include "../Source/SchedulerProtocol.h"
+#include "../Source/LocalQueues.h"
+#include "../Source/CoreBudget.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <functional>
+#include <random>
+#include <memory>
+#include <istream>
+#include <sstream>
+#include <string>
+
+namespace SchedulerSim {
+
+using ::Nirvana::Core::Windows::SchedulerMessage;
+using ::Nirvana::Core::Windows::SchedulerRing;
+using ::Nirvana::Core::Windows::SchedulerDeferral;
+using ::Nirvana::Core::Windows::SchedulerDispatch;
+using ::Nirvana::Core::Windows::LocalQueues;
+using ::Nirvana::Core::Windows::CoreBudget;
+
+/// Virtual time, ns.
+typedef uint64_t Time;
+
+/// Discrete event queue with the virtual clock.
+/// Events with the same time are processed in the order of addition.
+class Clock
+{
+public:
+	Clock () :
+		now_ (0),
+		seq_ (0)
+	{}
+
+	Time now () const
+	{
+		return now_;
+	}
+
+	void at (Time t, std::function <void ()> f)
+	{
+		events_.emplace (Key (t < now_ ? now_ : t, seq_++), std::move (f));
+	}
+
+	void after (Time d, std::function <void ()> f)
+	{
+		at (now_ + d, std::move (f));
+	}
+
+	bool step ()
+	{
+		if (events_.empty ())
+			return false;
+		auto it = events_.begin ();
+		now_ = it->first.first;
+		std::function <void ()> f = std::move (it->second);
+		events_.erase (it);
+		f ();
+		return true;
+	}
+
+	void run ()
+	{
+		while (step ())
+			;
+	}
+
+private:
+	typedef std::pair <Time, uint64_t> Key;
+
+	Time now_;
+	uint64_t seq_;
+	std::map <Key, std::function <void ()> > events_;
+};
+
+/// Workload item.
+struct Job
+{
+	Time arrival;
+	unsigned domain;
+	Time deadline; ///< Relative to the arrival
+	Time duration;
+};
+
+typedef std::vector <Job> Workload;
+
+/// Load the recorded workload.
+/// Each line contains `arrival domain deadline duration` in ns. Lines starting with `#` are ignored.
+/// \returns `false` if the input is malformed.
+inline bool load (std::istream& in, Workload& workload)
+{
+	std::string line;
+	while (std::getline (in, line)) {
+		if (line.empty () || line [0] == '#')
+			continue;
+		std::istringstream ss (line);
+		Job job;
+		if (!(ss >> job.arrival >> job.domain >> job.deadline >> job.duration))
+			return false;
+		workload.push_back (job);
+	}
+	return true;
+}
+
+/// Random periodic workload.
+/// \param load Average core utilization, 1.0 means all cores busy.
+inline Workload generate (unsigned domains, unsigned cores, size_t count, double load, uint64_t seed)
+{
+	std::mt19937_64 rnd (seed);
+	std::exponential_distribution <double> duration (1.0 / 50000);
+	Time mean_duration = 50000;
+	double interval = (double)mean_duration / cores / load;
+	std::exponential_distribution <double> gap (1.0 / interval);
+	Workload workload;
+	double t = 0;
+	for (size_t i = 0; i < count; ++i) {
+		t += gap (rnd);
+		Job job;
+		job.arrival = (Time)t;
+		job.domain = (unsigned)(rnd () % domains);
+		job.duration = (Time)duration (rnd) + 1000;
+		job.deadline = job.duration * 4 + rnd () % 200000;
+		workload.push_back (job);
+	}
+	return workload;
+}
+
+struct Config
+{
+	unsigned cores = 4;          ///< Number of the simulated cores
+	unsigned workers = 4;        ///< Worker threads per domain
+	uint32_t ring_capacity = 4096; ///< Shared ring capacity, 0 - use the pipe only
+	Time pipe_latency = 20000;   ///< Pipe message delivery time
+	Time pipe_jitter = 10000;    ///< Random addition to the pipe latency
+	bool postman_reorder = false; ///< Pipe messages overtake each other as with the concurrent postman threads
+	unsigned worker_submit = 0;  ///< Percentage of the jobs submitted by the running executors
+	Time grant_latency = 5000;   ///< Semaphore release to the worker wake-up
+	Time throttle_delay = 100000000; ///< Deadline delay of the throttled domain item
+	std::vector <std::pair <unsigned, unsigned> > budgets; ///< Domain core quota and weight
+	uint64_t seed = 1;
+};
+
+struct Result
+{
+	size_t executed = 0;
+	size_t missed = 0;           ///< Completed after the deadline
+	Time max_lateness = 0;
+	Time makespan = 0;
+	size_t records = 0;          ///< Records sent by the domains
+	size_t pipe_messages = 0;
+	size_t ring_full = 0;
+	size_t stale_grants = 0;     ///< Grants to the terminated domains
+	size_t throttled = 0;        ///< Grants deferred by the core budget
+	std::vector <size_t> domain_missed; ///< Deadline misses per domain
+	std::vector <size_t> domain_executed; ///< Executed jobs per domain
+	size_t unreserved = 0;       ///< Master queue insertions without the reserved item
+	unsigned free_cores = 0;     ///< Master free cores after the run
+	int64_t reserved = 0;        ///< Master reserved items after the run
+
+	double throughput () const
+	{
+		return makespan ? executed * 1e9 / makespan : 0;
+	}
+
+	bool operator == (const Result& r) const
+	{
+		return executed == r.executed && missed == r.missed && max_lateness == r.max_lateness
+			&& makespan == r.makespan && records == r.records && pipe_messages == r.pipe_messages
+			&& ring_full == r.ring_full && stale_grants == r.stale_grants && throttled == r.throttled
+			&& domain_missed == r.domain_missed && domain_executed == r.domain_executed
+			&& unreserved == r.unreserved && free_cores == r.free_cores && reserved == r.reserved;
+	}
+};
+
+class Simulator
+{
+	class Process;
+	class Domain;
+
+	/// Master scheduler model. EDF queue of the domain items and the free core counter.
+	class Master
+	{
+	public:
+		Master (Result& result, unsigned cores) :
+			result_ (result),
+			free_cores_ (cores),
+			reserved_ (0)
+		{}
+
+		void create_item (bool with_reschedule)
+		{
+			reserved_ += with_reschedule ? 2 : 1;
+		}
+
+		void delete_item (bool with_reschedule)
+		{
+			reserved_ -= with_reschedule ? 2 : 1;
+		}
+
+		void schedule (Time deadline, Process& process)
+		{
+			if ((int64_t)queue_.size () >= reserved_)
+				++result_.unreserved;
+			process.enqueued ();
+			queue_.emplace (deadline, Item { &process, deadline, 0 });
+			dispatch ();
+		}
+
+		/// Requeue the extracted item from Process::execute ().
+		void requeue (Time key, Process& process, Time deadline, Time delay)
+		{
+			process.enqueued ();
+			queue_.emplace (key, Item { &process, deadline, delay });
+		}
+
+		/// \returns Number of the items in the queue.
+		size_t queued () const
+		{
+			return queue_.size ();
+		}
+
+		bool reschedule (Time deadline, Process& process, Time old)
+		{
+			auto range = queue_.equal_range (old);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second.process == &process) {
+					Item item = it->second;
+					item.deadline = deadline;
+					queue_.erase (it);
+					queue_.emplace (deadline, item);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void core_free ()
+		{
+			++free_cores_;
+			dispatch ();
+		}
+
+		unsigned free_cores () const
+		{
+			return free_cores_;
+		}
+
+		int64_t reserved () const
+		{
+			return reserved_;
+		}
+
+	private:
+		void dispatch ()
+		{
+			while (free_cores_ && !queue_.empty ()) {
+				auto it = queue_.begin ();
+				Item item = it->second;
+				queue_.erase (it);
+				--free_cores_;
+				if (!item.process->execute (item.deadline, item.delay))
+					++free_cores_;
+			}
+		}
+
+	private:
+		Result& result_;
+		unsigned free_cores_;
+		int64_t reserved_;
+
+		// SchedulerItem
+		struct Item
+		{
+			Process* process;
+			Time deadline;
+			Time delay; // Accumulated throttle delay
+		};
+
+		std::multimap <Time, Item> queue_;
+	};
+
+	/// SchedulerProcess model.
+	class Process
+	{
+	public:
+		/// \param quota, weight The core budget the domain is created with.
+		Process (Simulator& sim, Domain& domain, unsigned quota, unsigned weight) :
+			sim_ (sim),
+			domain_ (domain),
+			valid_cnt_ (1),
+			used_cores_ (0),
+			created_items_ (0),
+			queued_ (0)
+		{
+			budget_.set (quota, weight);
+			sim_.total_weight_ += weight;
+		}
+
+		void enqueued ()
+		{
+			++queued_;
+		}
+
+		bool execute (Time deadline, Time delay)
+		{
+			--queued_;
+			if (!valid_cnt_) {
+				++sim_.result_.stale_grants;
+				return false;
+			}
+			if (!budget_.admit (used_cores_, sim_.config_.cores, sim_.total_weight_)) {
+				// Borrow the idle capacity only
+				if (!delay || sim_.master_.queued () > queued_) {
+					++sim_.result_.throttled;
+					delay += sim_.config_.throttle_delay;
+					sim_.master_.requeue (std::max (deadline, sim_.clock_.now ()) + delay, *this, deadline, delay);
+					return false;
+				}
+			}
+			++used_cores_;
+			sim_.clock_.after (sim_.config_.grant_latency, [this] () { domain_.grant (); });
+			return true;
+		}
+
+		void receive (const SchedulerMessage::Frame& frame)
+		{
+			if (valid_cnt_) {
+				bool ok = SchedulerMessage::parse (frame.data (), frame.size (), [this] (const SchedulerMessage::Header& rec) {
+					SchedulerDispatch <Process>::record (*this, rec);
+				});
+				assert (ok);
+				(void)ok;
+			}
+		}
+
+		void broken_pipe ()
+		{
+			if (valid_cnt_ && !--valid_cnt_) {
+				sim_.total_weight_ -= budget_.weight ();
+				terminate ();
+			}
+		}
+
+	private:
+		friend class SchedulerDispatch <Process>;
+
+		// Record handlers called by SchedulerDispatch.
+
+		void create_item (bool with_reschedule)
+		{
+			sim_.master_.create_item (with_reschedule);
+			created_items_ += with_reschedule ? 2 : 1;
+		}
+
+		void delete_item (bool with_reschedule)
+		{
+			created_items_ -= with_reschedule ? 2 : 1;
+			sim_.master_.delete_item (with_reschedule);
+		}
+
+		void schedule (Time deadline)
+		{
+			sim_.master_.schedule (deadline, *this);
+		}
+
+		void reschedule (Time deadline, Time old)
+		{
+			sim_.master_.reschedule (deadline, *this, old);
+		}
+
+		void core_free ()
+		{
+			--used_cores_;
+			sim_.master_.core_free ();
+		}
+
+		SchedulerRing <SchedulerMessage::Record>& ring ()
+		{
+			return domain_.ring ();
+		}
+
+		void on_error ()
+		{
+			assert (false);
+		}
+
+		void terminate ()
+		{
+			Master& master = sim_.master_;
+			for (; used_cores_; --used_cores_) {
+				master.core_free ();
+			}
+			for (; created_items_ > 0; --created_items_) {
+				master.delete_item (false);
+			}
+		}
+
+	private:
+		Simulator& sim_;
+		Domain& domain_;
+		int valid_cnt_;
+		unsigned used_cores_;
+		int created_items_;
+		size_t queued_;
+		CoreBudget budget_;
+	};
+
+	/// Domain queue. Single-threaded priority queue for LocalQueues.
+	class Queue
+	{
+	public:
+		bool insert (Time deadline, size_t job)
+		{
+			map_.emplace (deadline, job);
+			return true;
+		}
+
+		bool delete_min (size_t& job)
+		{
+			if (map_.empty ())
+				return false;
+			job = map_.begin ()->second;
+			map_.erase (map_.begin ());
+			return true;
+		}
+
+		bool reorder (Time deadline, size_t job, Time old)
+		{
+			auto range = map_.equal_range (old);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second == job) {
+					map_.erase (it);
+					map_.emplace (deadline, job);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		Time get_min_deadline () const
+		{
+			return map_.empty () ? 0 : map_.begin ()->first;
+		}
+
+	private:
+		std::multimap <Time, size_t> map_;
+	};
+
+	/// SchedulerSlave model.
+	class Domain
+	{
+	public:
+		Domain (Simulator& sim, unsigned index, unsigned quota, unsigned weight) :
+			sim_ (sim),
+			index_ (index),
+			process_ (sim, *this, quota, weight),
+			queues_ (global_, sim.config_.workers, 0),
+			idle_ (sim.config_.workers),
+			deferred_ (sim.config_.workers, SchedulerMessage::Header::TAG_COUNT),
+			spawned_ (sim.config_.workers),
+			pending_grants_ (0),
+			last_delivery_ (0),
+			alive_ (true)
+		{
+			for (unsigned i = 0; i < idle_.size (); ++i) {
+				idle_ [i] = i;
+			}
+			if (sim.config_.ring_capacity) {
+				size_t size = SchedulerRing <SchedulerMessage::Record>::required_size (sim.config_.ring_capacity);
+				ring_mem_.reset (new uint64_t [size / sizeof (uint64_t) + 1] ());
+				ring_.create (ring_mem_.get (), size, sim.config_.ring_capacity);
+			}
+		}
+
+		SchedulerRing <SchedulerMessage::Record>& ring ()
+		{
+			return ring_;
+		}
+
+		Process& process ()
+		{
+			return process_;
+		}
+
+		/// New executor arrived.
+		/// It is submitted from outside of the worker threads or, with Config::worker_submit,
+		/// by a running executor at its end.
+		void submit (size_t job)
+		{
+			if (!alive_)
+				return;
+			if (sim_.config_.worker_submit && sim_.rnd_ () % 100 < sim_.config_.worker_submit) {
+				std::vector <unsigned> busy;
+				for (unsigned worker = 0; worker < spawned_.size (); ++worker) {
+					if (std::find (idle_.begin (), idle_.end (), worker) == idle_.end ())
+						busy.push_back (worker);
+				}
+				if (!busy.empty ()) {
+					spawned_ [busy [sim_.rnd_ () % busy.size ()]].push_back (job);
+					return;
+				}
+			}
+			enqueue (LocalQueues <Queue>::NOT_WORKER, job);
+		}
+
+		/// The master granted a core.
+		void grant ()
+		{
+			if (!alive_)
+				return;
+			++pending_grants_;
+			run_workers ();
+		}
+
+		/// Terminate the domain. The pipe is closed after all sent messages are delivered.
+		void kill ()
+		{
+			alive_ = false;
+			Time t = std::max (last_delivery_, sim_.clock_.now ()) + 1;
+			sim_.clock_.at (t, [this] () { process_.broken_pipe (); });
+		}
+
+	private:
+		SchedulerMessage::Header::Tag* deferred (unsigned worker)
+		{
+			return LocalQueues <Queue>::NOT_WORKER != worker ? &deferred_ [worker] : nullptr;
+		}
+
+		auto sender ()
+		{
+			return [this] (const auto& rec) { send (rec); };
+		}
+
+		/// Create the item and schedule it as the Core does.
+		void enqueue (unsigned worker, size_t job)
+		{
+			Time deadline = sim_.clock_.now () + sim_.workload_ [job].deadline;
+			SchedulerDeferral::create_item (deferred (worker), false, sender ());
+			queues_.insert (worker, deadline, job);
+			SchedulerDeferral::schedule (deferred (worker), deadline, sender ());
+		}
+
+		void run_workers ()
+		{
+			while (pending_grants_ && !idle_.empty ()) {
+				--pending_grants_;
+				unsigned worker = idle_.back ();
+				idle_.pop_back ();
+				size_t job;
+				uint64_t deadline;
+				bool ok = queues_.delete_min (worker, job, deadline);
+				assert (ok); // Each grant corresponds to the scheduled executor
+				(void)ok;
+				sim_.clock_.after (sim_.workload_ [job].duration, [this, worker, deadline] () {
+					completed (worker, deadline);
+				});
+			}
+		}
+
+		void completed (unsigned worker, Time deadline)
+		{
+			if (!alive_)
+				return;
+			Result& result = sim_.result_;
+			Time now = sim_.clock_.now ();
+			++result.executed;
+			++result.domain_executed [index_];
+			if (now > deadline) {
+				++result.missed;
+				++result.domain_missed [index_];
+				if (result.max_lateness < now - deadline)
+					result.max_lateness = now - deadline;
+			}
+			if (result.makespan < now)
+				result.makespan = now;
+			// The executor item is deleted, then the executor submits the new ones.
+			SchedulerDeferral::delete_item (deferred (worker), false, sender ());
+			for (size_t job : spawned_ [worker]) {
+				enqueue (worker, job);
+			}
+			spawned_ [worker].clear ();
+			SchedulerDeferral::core_free (deferred (worker), sender ());
+			idle_.push_back (worker);
+			run_workers ();
+		}
+
+		template <class Rec>
+		void send (const Rec& rec)
+		{
+			++sim_.result_.records;
+			if (ring_.is_attached ()) {
+				bool signal;
+				if (ring_.push (rec, signal)) {
+					if (signal)
+						post (SchedulerMessage::Tagged (SchedulerMessage::Header::RING_SIGNAL));
+					return;
+				}
+				++sim_.result_.ring_full;
+			}
+			post (rec);
+		}
+
+		template <class Rec>
+		void post (const Rec& rec)
+		{
+			++sim_.result_.pipe_messages;
+			SchedulerMessage::Frame frame;
+			frame.append (rec);
+			Time t = sim_.clock_.now () + sim_.config_.pipe_latency;
+			if (sim_.config_.pipe_jitter)
+				t += sim_.rnd_ () % sim_.config_.pipe_jitter;
+			if (!sim_.config_.postman_reorder && t <= last_delivery_)
+				t = last_delivery_ + 1;
+			if (last_delivery_ < t)
+				last_delivery_ = t;
+			sim_.clock_.at (t, [this, frame] () { process_.receive (frame); });
+		}
+
+	private:
+		Simulator& sim_;
+		const unsigned index_;
+		Process process_;
+		Queue global_;
+		LocalQueues <Queue> queues_;
+		std::unique_ptr <uint64_t []> ring_mem_;
+		SchedulerRing <SchedulerMessage::Record> ring_;
+		std::vector <unsigned> idle_;
+		std::vector <SchedulerMessage::Header::Tag> deferred_; // Deferred item records of the workers
+		std::vector <std::vector <size_t> > spawned_; // Jobs submitted by the running executors
+		unsigned pending_grants_;
+		Time last_delivery_;
+		bool alive_;
+	};
+
+public:
+	Simulator (const Config& config, const Workload& workload) :
+		config_ (config),
+		workload_ (workload),
+		master_ (result_, config.cores),
+		rnd_ (config.seed),
+		total_weight_ (0)
+	{}
+
+	/// Terminate the domain at the given time.
+	void kill (unsigned domain, Time t)
+	{
+		kills_.emplace_back (domain, t);
+	}
+
+	const Result& run ()
+	{
+		unsigned domains = 0;
+		for (const Job& job : workload_) {
+			if (domains <= job.domain)
+				domains = job.domain + 1;
+		}
+		result_.domain_missed.resize (domains);
+		result_.domain_executed.resize (domains);
+		for (unsigned i = 0; i < domains; ++i) {
+			unsigned quota = 0, weight = 0;
+			if (i < config_.budgets.size ()) {
+				quota = config_.budgets [i].first;
+				weight = config_.budgets [i].second;
+			}
+			domains_.emplace_back (new Domain (*this, i, quota, weight));
+		}
+		for (size_t i = 0; i < workload_.size (); ++i) {
+			const Job& job = workload_ [i];
+			Domain* domain = domains_ [job.domain].get ();
+			clock_.at (job.arrival, [domain, i] () { domain->submit (i); });
+		}
+		for (const auto& k : kills_) {
+			if (k.first < domains) {
+				Domain* domain = domains_ [k.first].get ();
+				clock_.at (k.second, [domain] () { domain->kill (); });
+			}
+		}
+		clock_.run ();
+		result_.free_cores = master_.free_cores ();
+		result_.reserved = master_.reserved ();
+		return result_;
+	}
+
+private:
+	const Config config_;
+	const Workload& workload_;
+	Clock clock_;
+	Result result_;
+	Master master_;
+	std::mt19937_64 rnd_;
+	std::vector <std::unique_ptr <Domain> > domains_;
+	std::vector <std::pair <unsigned, Time> > kills_;
+	unsigned total_weight_;
+};
+
+}
+
+#endif
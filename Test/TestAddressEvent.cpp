@@ -0,0 +1,146 @@
+// Hand-off latency from a worker to a background thread: kernel event vs address event.
+#include "../Source/AddressEvent.h"
+#include "../Source/win32.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace TestAddressEvent {
+
+using namespace ::Nirvana::Core::Windows;
+
+class TestAddressEvent :
+	public ::testing::Test
+{
+protected:
+	TestAddressEvent ()
+	{}
+
+	virtual ~TestAddressEvent ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// The worker hands off a short step to the background thread each `interval`
+// and waits for the step completion.
+// Set and Wait are the event operations.
+template <class Set, class Wait>
+std::vector <uint64_t> hand_off (Set set, Wait wait, std::chrono::microseconds interval, unsigned count)
+{
+	std::atomic <int64_t> released (0);
+	std::atomic <unsigned> done (0);
+	std::vector <uint64_t> latency;
+	latency.reserve (count);
+
+	std::thread background ([&] () {
+		SetThreadPriority (GetCurrentThread (), BACKGROUND_THREAD_PRIORITY);
+		for (unsigned i = 0; i < count; ++i) {
+			wait ();
+			latency.push_back (std::chrono::duration_cast <std::chrono::nanoseconds> (
+				Clock::now ().time_since_epoch ()).count () - released.load (std::memory_order_acquire));
+			done.fetch_add (1, std::memory_order_release);
+		}
+	});
+
+	SetThreadPriority (GetCurrentThread (), WORKER_THREAD_PRIORITY);
+	for (unsigned i = 0; i < count; ++i) {
+		auto next = Clock::now () + interval;
+		while (Clock::now () < next)
+			std::this_thread::yield ();
+		released.store (std::chrono::duration_cast <std::chrono::nanoseconds> (
+			Clock::now ().time_since_epoch ()).count (), std::memory_order_release);
+		set ();
+		while (done.load (std::memory_order_acquire) <= i)
+			std::this_thread::yield ();
+	}
+	background.join ();
+	SetThreadPriority (GetCurrentThread (), THREAD_PRIORITY_NORMAL);
+	std::sort (latency.begin (), latency.end ());
+	return latency;
+}
+
+static uint64_t percentile (const std::vector <uint64_t>& sorted, unsigned p)
+{
+	return sorted [(sorted.size () - 1) * p / 100];
+}
+
+TEST_F (TestAddressEvent, Signal)
+{
+	AddressEvent ev;
+	WorkerGate::SpinPolicy policy (0);
+	ev.set ();
+	ev.set ();
+	// Auto-reset: two sets before the wait release one wait.
+	ev.wait (policy);
+
+	std::atomic <bool> woken (false);
+	std::thread waiter ([&] () {
+		WorkerGate::SpinPolicy policy (WORKER_SPIN_MAX);
+		ev.wait (policy);
+		woken = true;
+	});
+	std::this_thread::sleep_for (std::chrono::milliseconds (50));
+	EXPECT_FALSE (woken.load ());
+	ev.set ();
+	waiter.join ();
+	EXPECT_TRUE (woken.load ());
+}
+
+TEST_F (TestAddressEvent, HandOffLatency)
+{
+	static const unsigned COUNT = 5000;
+	static const std::chrono::microseconds INTERVAL (20);
+
+	HANDLE event = CreateEventW (nullptr, false, false, nullptr);
+	ASSERT_TRUE (event);
+	std::vector <uint64_t> kernel = hand_off (
+		[event] () { SetEvent (event); },
+		[event] () { WaitForSingleObject (event, INFINITE); },
+		INTERVAL, COUNT);
+	CloseHandle (event);
+
+	AddressEvent ev;
+	std::vector <uint64_t> park = hand_off (
+		[&ev] () { ev.set (); },
+		[&ev] () { static thread_local WorkerGate::SpinPolicy policy (0); ev.wait (policy); },
+		INTERVAL, COUNT);
+
+	std::vector <uint64_t> spin = hand_off (
+		[&ev] () { ev.set (); },
+		[&ev] () { static thread_local WorkerGate::SpinPolicy policy (WORKER_SPIN_MAX); ev.wait (policy); },
+		INTERVAL, COUNT);
+
+	std::cout << "SetEvent/WaitForSingleObject: p50 " << percentile (kernel, 50) << " ns, p99 "
+		<< percentile (kernel, 99) << " ns" << std::endl;
+	std::cout << "WaitOnAddress:                p50 " << percentile (park, 50) << " ns, p99 "
+		<< percentile (park, 99) << " ns" << std::endl;
+	std::cout << "Spin then WaitOnAddress:      p50 " << percentile (spin, 50) << " ns, p99 "
+		<< percentile (spin, 99) << " ns" << std::endl;
+
+	// Spinning is useless on the single processor.
+	if (std::thread::hardware_concurrency () > 1) {
+		EXPECT_LT (percentile (spin, 50), percentile (kernel, 50));
+	}
+}
+
+}
@@ -0,0 +1,93 @@
+// Block directory lookup benchmark.
+#include <Nirvana/Nirvana.h>
+#include "../Source/AddressSpace.inl"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+
+namespace TestBlockLookup {
+
+using namespace ::Nirvana::Core::Windows;
+
+typedef AddressSpace <sizeof (void*) == 8> Space;
+
+class TestBlockLookup :
+	public ::testing::Test
+{
+protected:
+	TestBlockLookup ()
+	{}
+
+	virtual ~TestBlockLookup ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		ASSERT_TRUE (space_.initialize (GetCurrentProcessId (), GetCurrentProcess ()));
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+	static const size_t BLOCKS = 128;
+	static const uint64_t STRIDE = 0x8000000000; // 512G, each block in the separate directory page
+
+	Space::Address address (size_t i) const
+	{
+		return (Space::Address)(uintptr_t)(STRIDE * (i + 1));
+	}
+
+protected:
+	Space space_;
+};
+
+TEST_F (TestBlockLookup, Lookup)
+{
+	static const size_t COUNT = 1000000;
+
+	// The directory has two levels on x64 only.
+	if (sizeof (void*) < 8)
+		return;
+
+	// Not committed directory pages
+	for (size_t i = 0; i < BLOCKS; ++i) {
+		EXPECT_FALSE (space_.allocated_block (address (i)));
+	}
+
+	// Commit directory pages for the half of blocks
+	for (size_t i = 0; i < BLOCKS; i += 2) {
+		space_.block (address (i));
+	}
+
+	auto t0 = std::chrono::steady_clock::now ();
+	size_t found = 0;
+	for (size_t i = 0; i < COUNT; ++i) {
+		if (space_.allocated_block (address (i % BLOCKS)))
+			++found;
+	}
+	std::chrono::duration <double, std::nano> lookup = std::chrono::steady_clock::now () - t0;
+	EXPECT_EQ (found, 0); // The blocks have no mapping
+
+	// The former implementation queried the directory page on each lookup.
+	t0 = std::chrono::steady_clock::now ();
+	for (size_t i = 0; i < COUNT; ++i) {
+		MEMORY_BASIC_INFORMATION mbi;
+		VirtualQuery ((void*)(uintptr_t)address (i % BLOCKS), &mbi, sizeof (mbi));
+	}
+	std::chrono::duration <double, std::nano> query = std::chrono::steady_clock::now () - t0;
+
+	std::cout << "Bitmap lookup: " << lookup.count () / COUNT << " ns, VirtualQuery: "
+		<< query.count () / COUNT << " ns" << std::endl;
+
+	EXPECT_LT (lookup.count (), query.count ());
+}
+
+}
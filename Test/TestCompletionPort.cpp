@@ -0,0 +1,157 @@
+// Completion port packet rate benchmark: single packet dequeue vs batch dequeue.
+#include "../Source/CompletionPort.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+namespace TestCompletionPort {
+
+using namespace ::Nirvana::Core::Windows;
+
+class TestCompletionPort :
+	public ::testing::Test
+{
+protected:
+	TestCompletionPort ()
+	{}
+
+	virtual ~TestCompletionPort ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+class Port :
+	public CompletionPort,
+	public CompletionPortReceiver
+{
+public:
+	/// \param ordered Check that the packets are received in the post order.
+	///   The packets must be posted by one thread with the tags 1, 2, 3 ...
+	Port (bool ordered = false) :
+		ordered_ (ordered),
+		out_of_order_ (0),
+		received_ (0)
+	{
+		CompletionPort::start ();
+	}
+
+	void post (size_t tag)
+	{
+		CompletionPort::post (*this, reinterpret_cast <OVERLAPPED*> (tag), 0);
+	}
+
+	size_t received () const
+	{
+		return received_.load ();
+	}
+
+	size_t out_of_order () const
+	{
+		return out_of_order_;
+	}
+
+private:
+	virtual void completed (OVERLAPPED* ovl, uint32_t size, uint32_t error) noexcept override
+	{
+		EXPECT_FALSE (error);
+		EXPECT_TRUE (ovl);
+		size_t cnt = received_.fetch_add (1, std::memory_order_relaxed) + 1;
+		if (ordered_ && reinterpret_cast <size_t> (ovl) != cnt)
+			++out_of_order_;
+	}
+
+private:
+	const bool ordered_;
+	size_t out_of_order_;
+	std::atomic <size_t> received_;
+};
+
+// Bursty load: producers post bursts of packets, consumers drain the port.
+// \returns Packets per second.
+static double packet_rate (unsigned batch)
+{
+	static const size_t BURST = 64;
+	static const size_t BURSTS = 20000;
+
+	Port port;
+	unsigned consumers = std::max (std::thread::hardware_concurrency () / 2, 1u);
+	unsigned producers = consumers;
+	std::vector <std::thread> threads;
+	for (unsigned i = 0; i < consumers; ++i) {
+		threads.emplace_back ([&port, batch] () { port.thread_proc (batch); });
+	}
+
+	auto t0 = std::chrono::steady_clock::now ();
+	std::vector <std::thread> posters;
+	for (unsigned i = 0; i < producers; ++i) {
+		posters.emplace_back ([&port, producers] () {
+			for (size_t b = 0; b < BURSTS / producers; ++b) {
+				for (size_t i = 1; i <= BURST; ++i) {
+					port.post (i);
+				}
+				std::this_thread::yield ();
+			}
+		});
+	}
+	for (auto& t : posters) {
+		t.join ();
+	}
+	size_t total = BURSTS / producers * producers * BURST;
+	while (port.received () < total) {
+		std::this_thread::yield ();
+	}
+	std::chrono::duration <double> dur = std::chrono::steady_clock::now () - t0;
+
+	port.terminate ();
+	for (auto& t : threads) {
+		t.join ();
+	}
+	EXPECT_EQ (port.received (), total);
+	return total / dur.count ();
+}
+
+TEST_F (TestCompletionPort, PacketRate)
+{
+	double single = packet_rate (1);
+	double batch = packet_rate (CompletionPort::BATCH_MAX);
+	std::cout << "GetQueuedCompletionStatus:   " << (uint64_t)single << " packets/s" << std::endl;
+	std::cout << "GetQueuedCompletionStatusEx: " << (uint64_t)batch << " packets/s" << std::endl;
+}
+
+TEST_F (TestCompletionPort, BatchOrder)
+{
+	static const size_t COUNT = 100000;
+
+	// One consumer receives the batches in the post order.
+	Port port (true);
+	std::thread consumer ([&port] () { port.thread_proc (CompletionPort::BATCH_MAX); });
+	for (size_t i = 1; i <= COUNT; ++i) {
+		port.post (i);
+	}
+	while (port.received () < COUNT) {
+		std::this_thread::yield ();
+	}
+	port.terminate ();
+	consumer.join ();
+	EXPECT_EQ (port.received (), COUNT);
+	EXPECT_EQ (port.out_of_order (), 0u);
+}
+
+}
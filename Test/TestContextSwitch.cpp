@@ -0,0 +1,209 @@
+// User-mode context switch tests and switch cost benchmark. Does not depend on Windows API.
+// Build with ../Source/ContextSwitch.cpp.
+#include "../Source/ContextSwitch.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <iostream>
+#ifndef _WIN32
+#include <ucontext.h>
+#endif
+
+namespace TestContextSwitch {
+
+using ::Nirvana::Core::Windows::ContextSwitch;
+
+class TestContextSwitch :
+	public ::testing::Test
+{
+protected:
+	TestContextSwitch ()
+	{}
+
+	virtual ~TestContextSwitch ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+static const size_t STACK_SIZE = 0x10000;
+
+// Context with own stack. The entry procedure switches back to the owner after each step.
+class Context
+{
+public:
+	Context (ContextSwitch::Entry entry) :
+		stack_ (new uint8_t [STACK_SIZE]),
+		owner_ (nullptr),
+		steps_ (0)
+	{
+		ContextSwitch::Stack stack = { stack_.get () + STACK_SIZE, stack_.get (), stack_.get () };
+		sp_ = ContextSwitch::make (stack, entry, this);
+	}
+
+	// Called by the owner.
+	void resume ()
+	{
+		ContextSwitch::swap (&owner_, sp_);
+	}
+
+	// Called by the context.
+	void yield ()
+	{
+		++steps_;
+		ContextSwitch::swap (&sp_, owner_);
+	}
+
+	unsigned steps () const
+	{
+		return steps_;
+	}
+
+private:
+	std::unique_ptr <uint8_t []> stack_;
+	void* sp_;
+	void* owner_;
+	unsigned steps_;
+};
+
+static void yield_proc (void* p)
+{
+	Context* context = (Context*)p;
+	for (;;) {
+		context->yield ();
+	}
+}
+
+TEST_F (TestContextSwitch, PingPong)
+{
+	Context context (yield_proc);
+	for (unsigned i = 1; i <= 1000; ++i) {
+		context.resume ();
+		EXPECT_EQ (context.steps (), i);
+	}
+}
+
+// Callee-saved integer and floating point values live across the switches.
+static volatile double fp_result;
+
+static void compute_proc (void* p)
+{
+	Context* context = (Context*)p;
+	double x = 1;
+	double y = 0.5;
+	uint64_t a = 1, b = 2, c = 3, d = 4, e = 5;
+	for (;;) {
+		x = x * 1.5 + y;
+		y = y * 0.5 + 1;
+		a += b; b += c; c += d; d += e; e += a;
+		fp_result = x + y + (double)(a ^ b ^ c ^ d ^ e);
+		context->yield ();
+	}
+}
+
+TEST_F (TestContextSwitch, Registers)
+{
+	Context context (compute_proc);
+
+	double x = 1;
+	double y = 0.5;
+	uint64_t a = 1, b = 2, c = 3, d = 4, e = 5;
+	for (int i = 0; i < 100; ++i) {
+		x = x * 1.5 + y;
+		y = y * 0.5 + 1;
+		a += b; b += c; c += d; d += e; e += a;
+		context.resume ();
+		EXPECT_EQ (fp_result, x + y + (double)(a ^ b ^ c ^ d ^ e));
+	}
+}
+
+// Context suspended in one thread is resumed in another.
+TEST_F (TestContextSwitch, Migration)
+{
+	Context context (yield_proc);
+	for (unsigned i = 1; i <= 10; ++i) {
+		std::thread thread ([&context] () { context.resume (); });
+		thread.join ();
+		EXPECT_EQ (context.steps (), i);
+	}
+}
+
+#ifndef _WIN32
+
+class UContext
+{
+public:
+	UContext () :
+		stack_ (new uint8_t [STACK_SIZE])
+	{
+		getcontext (&context_);
+		context_.uc_stack.ss_sp = stack_.get ();
+		context_.uc_stack.ss_size = STACK_SIZE;
+		context_.uc_link = nullptr;
+		makecontext (&context_, (void (*) ())proc, 0);
+		self_ = this;
+	}
+
+	void resume ()
+	{
+		swapcontext (&owner_, &context_);
+	}
+
+private:
+	static void proc ()
+	{
+		for (;;) {
+			swapcontext (&self_->context_, &self_->owner_);
+		}
+	}
+
+private:
+	std::unique_ptr <uint8_t []> stack_;
+	ucontext_t context_;
+	ucontext_t owner_;
+	static UContext* self_;
+};
+
+UContext* UContext::self_;
+
+TEST_F (TestContextSwitch, Benchmark)
+{
+	static const unsigned COUNT = 1000000;
+
+	Context context (yield_proc);
+	auto t0 = std::chrono::steady_clock::now ();
+	for (unsigned i = 0; i < COUNT; ++i) {
+		context.resume ();
+	}
+	std::chrono::duration <double, std::nano> swap = std::chrono::steady_clock::now () - t0;
+
+	UContext ucontext;
+	t0 = std::chrono::steady_clock::now ();
+	for (unsigned i = 0; i < COUNT; ++i) {
+		ucontext.resume ();
+	}
+	std::chrono::duration <double, std::nano> uswap = std::chrono::steady_clock::now () - t0;
+
+	// Each round trip is two switches.
+	std::cout << "ContextSwitch: " << swap.count () / COUNT / 2 << " ns per switch" << std::endl;
+	std::cout << "swapcontext:   " << uswap.count () / COUNT / 2 << " ns per switch" << std::endl;
+	EXPECT_LT (swap.count (), uswap.count ());
+}
+
+#endif
+
+}
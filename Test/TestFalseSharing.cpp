@@ -0,0 +1,184 @@
+// False sharing benchmark for the hot scheduler state layouts. Does not depend on Windows API.
+// The structures below copy the member order of the real classes before and after the padding
+// with the same member sizes. The real classes depend on Windows API and can not be used here.
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <iostream>
+
+namespace TestFalseSharing {
+
+class TestFalseSharing :
+	public ::testing::Test
+{
+protected:
+	TestFalseSharing ()
+	{}
+
+	virtual ~TestFalseSharing ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+	static const unsigned OPERATIONS = 2000000;
+
+	static unsigned threads ()
+	{
+		return std::max (std::thread::hardware_concurrency (), 2u);
+	}
+
+	// Runs the writers concurrently and returns operations per second.
+	template <class F>
+	static double run (unsigned count, F f)
+	{
+		std::atomic <bool> go (false);
+		std::vector <std::thread> workers;
+		for (unsigned t = 0; t < count; ++t) {
+			workers.emplace_back ([&go, &f, t] () {
+				while (!go.load (std::memory_order_acquire))
+					std::this_thread::yield ();
+				for (unsigned i = 0; i < OPERATIONS; ++i) {
+					f (t);
+				}
+			});
+		}
+		auto t0 = std::chrono::steady_clock::now ();
+		go.store (true, std::memory_order_release);
+		for (auto& w : workers) {
+			w.join ();
+		}
+		std::chrono::duration <double> dur = std::chrono::steady_clock::now () - t0;
+		return (double)OPERATIONS * count / dur.count ();
+	}
+
+	// The difference is visible on a multi-core system only, so the results are reported, not checked.
+	static void print (const char* name, double before, double after)
+	{
+		std::cout << name << " (" << std::thread::hardware_concurrency () << " processors): before "
+			<< (uint64_t)before << " ops/s, after " << (uint64_t)after << " ops/s" << std::endl;
+		if (std::thread::hardware_concurrency () < 2)
+			std::cout << "Single processor: the results do not show the false sharing effect." << std::endl;
+	}
+};
+
+// SchedulerProcess members after the read-mostly handles.
+// Writer 0 is the reference counter, writer 1 is grant_core/core_free, writer 2 is the item records,
+// writer 3 reads the handles as grant_core does.
+
+struct ProcessBefore
+{
+	void* scheduler;
+	void* semaphore;
+	void* pipe;
+	void* process_handle;
+	uint32_t process_id;
+	std::atomic <int> ref_cnt;
+	std::atomic <int> valid_cnt;
+	std::atomic <int> used_cores;
+	std::atomic <int> created_items;
+	std::atomic_flag terminated;
+};
+
+struct ProcessAfter
+{
+	void* scheduler;
+	void* semaphore;
+	void* pipe;
+	void* process_handle;
+	uint32_t process_id;
+	alignas (64) std::atomic <int> ref_cnt;
+	alignas (64) std::atomic <int> valid_cnt;
+	std::atomic <int> used_cores;
+	alignas (64) std::atomic <int> created_items;
+	std::atomic_flag terminated;
+};
+
+template <class Process>
+void process_writer (Process& p, unsigned writer)
+{
+	switch (writer % 4) {
+		case 0:
+			p.ref_cnt.fetch_add (1, std::memory_order_relaxed);
+			p.ref_cnt.fetch_sub (1, std::memory_order_release);
+			break;
+		case 1:
+			p.valid_cnt.fetch_add (1, std::memory_order_acquire);
+			p.used_cores.fetch_add (1, std::memory_order_relaxed);
+			p.used_cores.fetch_sub (1, std::memory_order_relaxed);
+			p.valid_cnt.fetch_sub (1, std::memory_order_release);
+			break;
+		case 2:
+			p.created_items.fetch_add (1, std::memory_order_relaxed);
+			p.created_items.fetch_sub (1, std::memory_order_relaxed);
+			break;
+		default:
+			if (!*(void* volatile*)&p.semaphore)
+				*(void* volatile*)&p.pipe;
+			break;
+	}
+}
+
+TEST_F (TestFalseSharing, ProcessCounters)
+{
+	unsigned cnt = std::min (threads (), 4u);
+	std::unique_ptr <ProcessBefore> before (new ProcessBefore ());
+	std::unique_ptr <ProcessAfter> after (new ProcessAfter ());
+	double before_ops = run (cnt, [&before] (unsigned t) { process_writer (*before, t); });
+	double after_ops = run (cnt, [&after] (unsigned t) { process_writer (*after, t); });
+	print ("SchedulerProcess", before_ops, after_ops);
+	EXPECT_EQ (before->created_items.load (), 0);
+	EXPECT_EQ (after->used_cores.load (), 0);
+}
+
+// SchedulerBase::BlockingState array written by the owner worker on each executor.
+
+struct StateBefore
+{
+	unsigned depth;
+	bool core_released;
+};
+
+struct alignas (64) StateAfter
+{
+	unsigned depth;
+	bool core_released;
+};
+
+template <class State>
+void state_writer (State* states, unsigned worker)
+{
+	volatile State& s = states [worker];
+	s.depth = s.depth + 1;
+	s.core_released = !s.core_released;
+	s.depth = s.depth - 1;
+}
+
+TEST_F (TestFalseSharing, WorkerState)
+{
+	unsigned cnt = threads ();
+	std::vector <StateBefore> before (cnt);
+	std::vector <StateAfter> after (cnt);
+	double before_ops = run (cnt, [&before] (unsigned t) { state_writer (before.data (), t); });
+	double after_ops = run (cnt, [&after] (unsigned t) { state_writer (after.data (), t); });
+	print ("BlockingState", before_ops, after_ops);
+	EXPECT_EQ (before [0].depth, 0u);
+	EXPECT_EQ (after [0].depth, 0u);
+}
+
+}
@@ -0,0 +1,166 @@
+// Execution context fiber pool tests and execution domain create/destroy benchmark.
+#include "../Source/FiberPool.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+
+namespace TestFiberPool {
+
+using namespace ::Nirvana::Core::Windows;
+
+class TestFiberPool :
+	public ::testing::Test
+{
+protected:
+	TestFiberPool ()
+	{}
+
+	virtual ~TestFiberPool ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		main_fiber_ = ConvertThreadToFiberEx (nullptr, FIBER_FLAG_FLOAT_SWITCH);
+		ASSERT_TRUE (main_fiber_);
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+		ConvertFiberToThread ();
+	}
+
+	// Execution domain emulation: run a job on the stack and return to the main fiber.
+	struct Domain
+	{
+		unsigned runs;
+		size_t stack_depth;
+	};
+
+	static void job (Domain& domain)
+	{
+		++domain.runs;
+		if (domain.stack_depth) {
+			volatile char buf [0x10000];
+			for (size_t i = 0; i < domain.stack_depth && i < sizeof (buf); i += PAGE_SIZE) {
+				buf [i] = 1;
+			}
+		}
+	}
+
+	// Fiber procedure like Port::ExecContext::fiber_proc.
+	static void __stdcall pooled_proc (void* p)
+	{
+		FiberPool::Fiber* fiber = (FiberPool::Fiber*)p;
+		for (;;) {
+			job (*(Domain*)fiber->param);
+			SwitchToFiber (main_fiber_);
+			FiberPool::trim_stack ();
+		}
+	}
+
+	static void __stdcall plain_proc (void* p)
+	{
+		for (;;) {
+			job (*(Domain*)p);
+			SwitchToFiber (main_fiber_);
+		}
+	}
+
+	static size_t committed_stack ()
+	{
+		NT_TIB* tib = (NT_TIB*)NtCurrentTeb ();
+		return (uint8_t*)tib->StackBase - (uint8_t*)tib->StackLimit;
+	}
+
+	static void __stdcall trim_proc (void* p)
+	{
+		FiberPool::Fiber* fiber = (FiberPool::Fiber*)p;
+		size_t* committed = (size_t*)fiber->param;
+		{
+			volatile char buf [FIBER_STACK_TRIM * 2];
+			for (size_t i = 0; i < sizeof (buf); i += PAGE_SIZE) {
+				buf [i] = 1;
+			}
+		}
+		committed [0] = committed_stack ();
+		FiberPool::trim_stack ();
+		committed [1] = committed_stack ();
+		SwitchToFiber (main_fiber_);
+		for (;;)
+			SwitchToFiber (main_fiber_);
+	}
+
+protected:
+	static void* main_fiber_;
+};
+
+void* TestFiberPool::main_fiber_;
+
+TEST_F (TestFiberPool, Reuse)
+{
+	FiberPool pool (pooled_proc);
+	Domain d1 = { 0, 0 }, d2 = { 0, 0 };
+
+	FiberPool::Fiber* f1 = pool.acquire (&d1);
+	SwitchToFiber (f1->handle);
+	EXPECT_EQ (d1.runs, 1);
+	pool.release (f1);
+
+	// The released fiber is reused by the next domain.
+	FiberPool::Fiber* f2 = pool.acquire (&d2);
+	EXPECT_EQ (f1, f2);
+	SwitchToFiber (f2->handle);
+	EXPECT_EQ (d1.runs, 1);
+	EXPECT_EQ (d2.runs, 1);
+	pool.release (f2);
+}
+
+TEST_F (TestFiberPool, Trim)
+{
+	FiberPool pool (trim_proc);
+	size_t committed [2] = { 0, 0 };
+	FiberPool::Fiber* fiber = pool.acquire (committed);
+	SwitchToFiber (fiber->handle);
+	EXPECT_GT (committed [0], FIBER_STACK_TRIM);
+	EXPECT_LE (committed [1], FIBER_STACK_COMMIT + 2 * PAGE_SIZE);
+	pool.release (fiber);
+}
+
+// Short-lived execution domains: create context, run once, destroy context.
+TEST_F (TestFiberPool, CreateDestroy)
+{
+	static const unsigned COUNT = 20000;
+
+	Domain domain = { 0, 0x8000 };
+	auto t0 = std::chrono::steady_clock::now ();
+	for (unsigned i = 0; i < COUNT; ++i) {
+		void* fiber = CreateFiberEx (0, 0, FIBER_FLAG_FLOAT_SWITCH, plain_proc, &domain);
+		ASSERT_TRUE (fiber);
+		SwitchToFiber (fiber);
+		DeleteFiber (fiber);
+	}
+	std::chrono::duration <double> plain = std::chrono::steady_clock::now () - t0;
+
+	FiberPool pool (pooled_proc);
+	t0 = std::chrono::steady_clock::now ();
+	for (unsigned i = 0; i < COUNT; ++i) {
+		FiberPool::Fiber* fiber = pool.acquire (&domain);
+		SwitchToFiber (fiber->handle);
+		pool.release (fiber);
+	}
+	std::chrono::duration <double> pooled = std::chrono::steady_clock::now () - t0;
+
+	EXPECT_EQ (domain.runs, COUNT * 2);
+	std::cout << "CreateFiberEx/DeleteFiber: " << (uint64_t)(COUNT / plain.count ()) << " domains/s" << std::endl;
+	std::cout << "Fiber pool:                " << (uint64_t)(COUNT / pooled.count ()) << " domains/s" << std::endl;
+	EXPECT_LT (pooled.count (), plain.count ());
+}
+
+}
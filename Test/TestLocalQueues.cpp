@@ -0,0 +1,176 @@
+// Local queues with stealing tests and scaling benchmark. Does not depend on Windows API.
+#include "../Source/LocalQueues.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+namespace TestLocalQueues {
+
+using ::Nirvana::Core::Windows::LocalQueues;
+
+// Simple priority queue with the interface of PriorityQueueReorder.
+class Queue
+{
+public:
+	Queue ()
+	{}
+
+	bool insert (uint64_t deadline, int val)
+	{
+		std::lock_guard <std::mutex> lock (mutex_);
+		map_.emplace (deadline, val);
+		return true;
+	}
+
+	bool delete_min (int& val)
+	{
+		std::lock_guard <std::mutex> lock (mutex_);
+		if (map_.empty ())
+			return false;
+		val = map_.begin ()->second;
+		map_.erase (map_.begin ());
+		return true;
+	}
+
+	bool reorder (uint64_t deadline, int val, uint64_t old)
+	{
+		std::lock_guard <std::mutex> lock (mutex_);
+		auto range = map_.equal_range (old);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == val) {
+				map_.erase (it);
+				map_.emplace (deadline, val);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint64_t get_min_deadline ()
+	{
+		std::lock_guard <std::mutex> lock (mutex_);
+		return map_.empty () ? 0 : map_.begin ()->first;
+	}
+
+private:
+	std::mutex mutex_;
+	std::multimap <uint64_t, int> map_;
+};
+
+typedef LocalQueues <Queue> Queues;
+
+class TestLocalQueues :
+	public ::testing::Test
+{
+protected:
+	TestLocalQueues ()
+	{}
+
+	virtual ~TestLocalQueues ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F (TestLocalQueues, Tolerance)
+{
+	Queue global;
+	Queues queues (global, 2, 10);
+
+	ASSERT_TRUE (queues.insert (0, 105, 1));
+	ASSERT_TRUE (queues.insert (Queues::NOT_WORKER, 100, 2));
+	ASSERT_TRUE (queues.insert (1, 120, 3));
+	EXPECT_EQ (queues.min_deadline (), 100);
+
+	int val;
+	// Worker 0 takes own executor within the tolerance.
+	ASSERT_TRUE (queues.delete_min (0, val));
+	EXPECT_EQ (val, 1);
+	// Worker 0 steals from the global queue.
+	ASSERT_TRUE (queues.delete_min (0, val));
+	EXPECT_EQ (val, 2);
+	// Worker 0 steals from the neighbour.
+	ASSERT_TRUE (queues.delete_min (0, val));
+	EXPECT_EQ (val, 3);
+	EXPECT_FALSE (queues.delete_min (0, val));
+	EXPECT_EQ (queues.min_deadline (), (uint64_t)Queues::EMPTY);
+
+	// Own executor out of the tolerance waits.
+	ASSERT_TRUE (queues.insert (1, 200, 4));
+	ASSERT_TRUE (queues.insert (0, 150, 5));
+	ASSERT_TRUE (queues.delete_min (1, val));
+	EXPECT_EQ (val, 5);
+
+	// Reorder finds the executor in any queue.
+	EXPECT_TRUE (queues.reorder (0, 50, 4, 200));
+	EXPECT_EQ (queues.min_deadline (), 50);
+	EXPECT_FALSE (queues.reorder (0, 60, 4, 200));
+}
+
+// Each worker schedules executors and executes them concurrently.
+// Each executor must be extracted exactly once.
+class Scaling
+{
+public:
+	static const unsigned OPERATIONS = 100000;
+
+	/// \returns Operations per second.
+	static double run (unsigned threads, bool local)
+	{
+		Queue global;
+		Queues queues (global, threads, 1000);
+		std::atomic <unsigned> extracted (0);
+		std::vector <std::thread> workers;
+		auto t0 = std::chrono::steady_clock::now ();
+		for (unsigned t = 0; t < threads; ++t) {
+			workers.emplace_back ([&queues, &extracted, t, local, threads] () {
+				unsigned worker = local ? t : Queues::NOT_WORKER;
+				unsigned cnt = OPERATIONS / threads;
+				for (unsigned i = 0; i < cnt; ++i) {
+					queues.insert (worker, (uint64_t)i * threads + t + 1, (int)t);
+					int val;
+					EXPECT_TRUE (queues.delete_min (worker, val));
+					++extracted;
+				}
+			});
+		}
+		for (auto& w : workers) {
+			w.join ();
+		}
+		std::chrono::duration <double> dur = std::chrono::steady_clock::now () - t0;
+		EXPECT_EQ (extracted.load (), OPERATIONS / threads * threads);
+		EXPECT_EQ (queues.min_deadline (), (uint64_t)Queues::EMPTY);
+		return extracted.load () / dur.count ();
+	}
+};
+
+TEST_F (TestLocalQueues, Scaling)
+{
+	unsigned max_threads = std::max (std::thread::hardware_concurrency (), 2u);
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+		double shared = Scaling::run (threads, false);
+		double local = Scaling::run (threads, true);
+		std::cout << threads << " threads: global queue " << (uint64_t)shared
+			<< " ops/s, local queues " << (uint64_t)local << " ops/s" << std::endl;
+	}
+}
+
+}
@@ -0,0 +1,169 @@
+// Block page state shadow tests.
+#include <Nirvana/Nirvana.h>
+#include "../Port/Memory.h"
+#include "../Source/Memory.inl"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string.h>
+
+namespace TestPageShadow {
+
+using namespace ::Nirvana::Core;
+using namespace ::Nirvana::Core::Windows;
+
+class TestPageShadow :
+	public ::testing::Test
+{
+protected:
+	TestPageShadow ()
+	{}
+
+	virtual ~TestPageShadow ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		ASSERT_TRUE (Port::Memory::initialize ());
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+		Port::Memory::terminate ();
+	}
+
+	// The counters exist in the debug build only. In the release build all counts are 0.
+	struct Counts
+	{
+#ifndef NDEBUG
+		Counts () :
+			requests (BlockState::request_count),
+			queries (BlockState::query_count)
+		{}
+
+		void print (const char* operation, size_t iterations)
+		{
+			requests = BlockState::request_count - requests;
+			queries = BlockState::query_count - queries;
+			std::cout << "Kernel queries for " << iterations << ' ' << operation
+				<< ": before " << requests << ", after " << queries << std::endl;
+		}
+#else
+		Counts () :
+			requests (0),
+			queries (0)
+		{}
+
+		void print (const char*, size_t)
+		{}
+#endif
+
+		size_t requests;
+		size_t queries;
+	};
+};
+
+TEST_F (TestPageShadow, Stamp)
+{
+	PageStateShadow shadow {};
+	shadow.invalidate ();
+
+	PageStateShadow::Stamp stamp;
+	uint8_t codes [PageStateShadow::PAGES];
+	ASSERT_FALSE (shadow.get (stamp, codes));
+	for (unsigned i = 0; i < PageStateShadow::PAGES; ++i) {
+		codes [i] = (uint8_t)(i % 8);
+	}
+	shadow.update (stamp, codes);
+
+	uint8_t loaded [PageStateShadow::PAGES];
+	PageStateShadow::Stamp stamp1;
+	ASSERT_TRUE (shadow.get (stamp1, loaded));
+	EXPECT_TRUE (std::equal (codes, std::end (codes), loaded));
+
+	// Update after the invalidation must be discarded.
+	shadow.invalidate ();
+	ASSERT_FALSE (shadow.get (stamp, loaded));
+	shadow.invalidate ();
+	shadow.update (stamp, codes);
+	EXPECT_FALSE (shadow.get (stamp, loaded));
+}
+
+TEST_F (TestPageShadow, Commit)
+{
+	static const size_t ITERATIONS = 1000;
+
+	size_t size = ALLOCATION_GRANULARITY;
+	BYTE* block = (BYTE*)Port::Memory::allocate (nullptr, size, Nirvana::Memory::RESERVED);
+	ASSERT_TRUE (block);
+
+	for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		Port::Memory::commit (block + offset, PAGE_SIZE);
+	}
+
+	Counts counts;
+	for (size_t i = 0; i < ITERATIONS; ++i) {
+		Port::Memory::commit (block + (i % PAGES_PER_BLOCK) * PAGE_SIZE, PAGE_SIZE);
+	}
+	counts.print ("commits", ITERATIONS);
+	EXPECT_LE (counts.queries, 1u);
+
+	// The shadow must be consistent with the real state.
+	Port::Memory::decommit (block + PAGE_SIZE, PAGE_SIZE);
+	EXPECT_TRUE (Port::Memory::is_writable (block, PAGE_SIZE));
+	EXPECT_FALSE (Port::Memory::is_readable (block + PAGE_SIZE, PAGE_SIZE));
+	Port::Memory::commit (block + PAGE_SIZE, PAGE_SIZE);
+	EXPECT_TRUE (Port::Memory::is_writable (block, size));
+
+	Port::Memory::release (block, size);
+}
+
+TEST_F (TestPageShadow, Copy)
+{
+	static const size_t ITERATIONS = 1000;
+	static const size_t COPY_SIZE = PAGE_SIZE / 2;
+
+	size_t size = ALLOCATION_GRANULARITY;
+	BYTE* src = (BYTE*)Port::Memory::allocate (nullptr, size, 0);
+	ASSERT_TRUE (src);
+	BYTE* dst = (BYTE*)Port::Memory::allocate (nullptr, size, 0);
+	ASSERT_TRUE (dst);
+	for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		src [offset] = (BYTE)(offset / PAGE_SIZE);
+	}
+
+	// The part of a page is copied without the remapping, the page states do not change.
+	Counts counts;
+	for (size_t i = 0; i < ITERATIONS; ++i) {
+		size_t offset = (i % PAGES_PER_BLOCK) * PAGE_SIZE;
+		size_t cb = COPY_SIZE;
+		Port::Memory::copy (dst + offset, src + offset, cb, 0);
+	}
+	counts.print ("partial page copies", ITERATIONS);
+	EXPECT_LE (counts.queries, counts.requests);
+
+	for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		EXPECT_EQ (dst [offset], (BYTE)(offset / PAGE_SIZE));
+	}
+
+	// The whole block copy shares the pages as copy-on-write, such pages are not cached.
+	Counts block_counts;
+	for (size_t i = 0; i < PAGES_PER_BLOCK; ++i) {
+		size_t cb = size;
+		Port::Memory::copy (dst, src, cb, 0);
+	}
+	block_counts.print ("block copies", PAGES_PER_BLOCK);
+	EXPECT_LE (block_counts.queries, block_counts.requests);
+	EXPECT_EQ (memcmp (dst, src, size), 0);
+
+	Port::Memory::release (dst, size);
+	Port::Memory::release (src, size);
+}
+
+}
@@ -0,0 +1,136 @@
+// Scheduler queue operation latency under the priority inversion.
+#include <Nirvana/Nirvana.h>
+#include <PriorityQueueReorder.h>
+#include <SkipListWithPool.h>
+#include "../Port/BackOff.h"
+#include "../Source/LocalQueues.h"
+#include "../Source/win32.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace TestSchedulerLatency {
+
+using namespace ::Nirvana::Core::Windows;
+using ::Nirvana::Core::Port::BackOff;
+using ::Nirvana::Core::PriorityQueueReorder;
+using ::Nirvana::Core::SkipListWithPool;
+using ::Nirvana::Core::SKIP_LIST_DEFAULT_LEVELS;
+
+class TestSchedulerLatency :
+	public ::testing::Test
+{
+protected:
+	TestSchedulerLatency ()
+	{}
+
+	virtual ~TestSchedulerLatency ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+// The slave queues: per-worker local queues with stealing and the global queue.
+// The processors are oversubscribed and one thread has the lower priority,
+// so it may be preempted inside a queue operation while the others wait for it.
+// With boost, each operation is wrapped into SetThreadPriority calls as Thread::PriorityBoost did.
+// Without boost, the operation runs in BackOff::SchedulerOperation scope as in SchedulerSlave.
+class Bench
+{
+	typedef PriorityQueueReorder <uintptr_t, SKIP_LIST_DEFAULT_LEVELS> Queue;
+
+public:
+	static const size_t OPERATIONS = 20000;
+
+	/// Runs concurrent insert/delete_min pairs and returns sorted latencies in nanoseconds.
+	static std::vector <uint64_t> run (unsigned threads, bool boost)
+	{
+		SkipListWithPool <Queue> global (threads);
+		LocalQueues <Queue> queues (global, threads, 0, threads);
+		std::vector <std::vector <uint64_t> > lat (threads);
+		std::vector <std::thread> workers;
+		for (unsigned t = 0; t < threads; ++t) {
+			workers.emplace_back ([&queues, &lat, t, boost] () {
+				HANDLE thread = GetCurrentThread ();
+				int priority = t ? WORKER_THREAD_PRIORITY : BACKGROUND_THREAD_PRIORITY;
+				SetThreadPriority (thread, priority);
+				std::vector <uint64_t>& v = lat [t];
+				v.reserve (OPERATIONS * 2);
+				for (size_t i = 0; i < OPERATIONS; ++i) {
+					uintptr_t val = ((uintptr_t)t << 24) | i;
+					uint64_t deadline = (uint64_t)i * 16 + t;
+					v.push_back (time (thread, priority, boost, [&] () {
+						ASSERT_TRUE (queues.insert (t, deadline, val));
+					}));
+					v.push_back (time (thread, priority, boost, [&] () {
+						uintptr_t min;
+						queues.delete_min (t, min); // May miss a concurrently stolen item
+					}));
+				}
+			});
+		}
+		for (auto& w : workers) {
+			w.join ();
+		}
+		std::vector <uint64_t> all;
+		for (const auto& v : lat) {
+			all.insert (all.end (), v.begin (), v.end ());
+		}
+		std::sort (all.begin (), all.end ());
+		return all;
+	}
+
+	static uint64_t percentile (const std::vector <uint64_t>& sorted, unsigned p)
+	{
+		return sorted [(sorted.size () - 1) * p / 100];
+	}
+
+private:
+	template <class Op>
+	static uint64_t time (HANDLE thread, int priority, bool boost, Op op)
+	{
+		auto t0 = std::chrono::steady_clock::now ();
+		if (boost) {
+			SetThreadPriority (thread, THREAD_PRIORITY_MAX);
+			op ();
+			SetThreadPriority (thread, priority);
+		} else {
+			BackOff::SchedulerOperation scope;
+			op ();
+		}
+		return std::chrono::duration_cast <std::chrono::nanoseconds> (
+			std::chrono::steady_clock::now () - t0).count ();
+	}
+};
+
+TEST_F (TestSchedulerLatency, PriorityInversion)
+{
+	unsigned threads = std::thread::hardware_concurrency () + 1;
+	std::vector <uint64_t> boosted = Bench::run (threads, true);
+	std::vector <uint64_t> plain = Bench::run (threads, false);
+
+	std::cout << "With priority boost: p50 " << Bench::percentile (boosted, 50)
+		<< " ns, p99 " << Bench::percentile (boosted, 99)
+		<< " ns, max " << boosted.back () << " ns" << std::endl;
+	std::cout << "Back-off escalation: p50 " << Bench::percentile (plain, 50)
+		<< " ns, p99 " << Bench::percentile (plain, 99)
+		<< " ns, max " << plain.back () << " ns" << std::endl;
+}
+
+}
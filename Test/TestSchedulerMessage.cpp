@@ -0,0 +1,201 @@
+// Scheduler pipe protocol tests.
+#include "../Source/SchedulerMessage.h"
+#include "../Source/win32.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+namespace TestSchedulerMessage {
+
+using namespace ::Nirvana::Core::Windows;
+using ::Nirvana::DeadlineTime;
+
+class TestSchedulerMessage :
+	public ::testing::Test
+{
+protected:
+	TestSchedulerMessage ()
+	{}
+
+	virtual ~TestSchedulerMessage ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F (TestSchedulerMessage, Parse)
+{
+	SchedulerMessage::Frame frame;
+	EXPECT_TRUE (frame.append (SchedulerMessage::Tagged (SchedulerMessage::Header::CREATE_ITEM)));
+	EXPECT_TRUE (frame.append (SchedulerMessage::Schedule (1)));
+	EXPECT_TRUE (frame.append (SchedulerMessage::ReSchedule (2, 1)));
+	EXPECT_TRUE (frame.append (SchedulerMessage::Tagged (SchedulerMessage::Header::CORE_FREE)));
+
+	std::vector <SchedulerMessage::Header::Tag> tags;
+	DeadlineTime deadlines = 0;
+	EXPECT_TRUE (SchedulerMessage::parse (frame.data (), frame.size (), [&tags, &deadlines] (const SchedulerMessage::Header& rec) {
+		tags.push_back (rec.tag);
+		if (SchedulerMessage::Header::SCHEDULE == rec.tag)
+			deadlines += static_cast <const SchedulerMessage::Schedule&> (rec).deadline;
+		else if (SchedulerMessage::Header::RESCHEDULE == rec.tag)
+			deadlines += static_cast <const SchedulerMessage::ReSchedule&> (rec).deadline;
+	}));
+	ASSERT_EQ (tags.size (), 4);
+	EXPECT_EQ (tags [0], SchedulerMessage::Header::CREATE_ITEM);
+	EXPECT_EQ (tags [1], SchedulerMessage::Header::SCHEDULE);
+	EXPECT_EQ (tags [2], SchedulerMessage::Header::RESCHEDULE);
+	EXPECT_EQ (tags [3], SchedulerMessage::Header::CORE_FREE);
+	EXPECT_EQ (deadlines, 3);
+
+	// Truncated frame
+	EXPECT_FALSE (SchedulerMessage::parse (frame.data (), frame.size () - 1, [] (const SchedulerMessage::Header&) {}));
+}
+
+// Combined item records.
+TEST_F (TestSchedulerMessage, Combined)
+{
+	SchedulerMessage::Frame frame;
+	EXPECT_TRUE (frame.append (SchedulerMessage::CreateSchedule (5, false)));
+	EXPECT_TRUE (frame.append (SchedulerMessage::CreateSchedule (7, true)));
+	EXPECT_TRUE (frame.append (SchedulerMessage::Tagged (SchedulerMessage::Header::DELETE2_CORE_FREE)));
+	EXPECT_EQ (frame.size (), 2 * sizeof (SchedulerMessage::Schedule) + sizeof (SchedulerMessage::Tagged));
+
+	std::vector <SchedulerMessage::Header::Tag> tags;
+	DeadlineTime deadlines = 0;
+	EXPECT_TRUE (SchedulerMessage::parse (frame.data (), frame.size (), [&tags, &deadlines] (const SchedulerMessage::Header& rec) {
+		tags.push_back (rec.tag);
+		if (SchedulerMessage::Header::CREATE_SCHEDULE == rec.tag || SchedulerMessage::Header::CREATE2_SCHEDULE == rec.tag)
+			deadlines += static_cast <const SchedulerMessage::CreateSchedule&> (rec).deadline;
+	}));
+	ASSERT_EQ (tags.size (), 3);
+	EXPECT_EQ (tags [0], SchedulerMessage::Header::CREATE_SCHEDULE);
+	EXPECT_EQ (tags [1], SchedulerMessage::Header::CREATE2_SCHEDULE);
+	EXPECT_EQ (tags [2], SchedulerMessage::Header::DELETE2_CORE_FREE);
+	EXPECT_EQ (deadlines, 12);
+
+	// The combined record fits the ring element.
+	SchedulerMessage::Record rec (SchedulerMessage::CreateSchedule (9, false));
+	EXPECT_EQ (rec.create_schedule.deadline, 9);
+}
+
+TEST_F (TestSchedulerMessage, Overflow)
+{
+	SchedulerMessage::Frame frame;
+	size_t cnt = 0;
+	while (frame.append (SchedulerMessage::Schedule (cnt)))
+		++cnt;
+	EXPECT_EQ (cnt, SchedulerMessage::MAX_FRAME_SIZE / sizeof (SchedulerMessage::Schedule));
+	EXPECT_LE (frame.size (), SchedulerMessage::MAX_FRAME_SIZE);
+}
+
+// Throughput of the scheduler pipe: one record per message vs. multi-record frames.
+class PipeBench
+{
+public:
+	PipeBench () :
+		records_ (0)
+	{
+		WCHAR name [64];
+		wsprintfW (name, L"\\\\.\\pipe\\NirvanaTest/scheduler%u", GetCurrentProcessId ());
+		server_ = CreateNamedPipeW (name, PIPE_ACCESS_INBOUND,
+			PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_REJECT_REMOTE_CLIENTS,
+			1, 0, 0, 0, nullptr);
+		client_ = CreateFileW (name, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		ConnectNamedPipe (server_, nullptr);
+		reader_ = std::thread (&PipeBench::read_proc, this);
+	}
+
+	~PipeBench ()
+	{
+		CloseHandle (client_);
+		reader_.join ();
+		CloseHandle (server_);
+	}
+
+	bool valid () const
+	{
+		return INVALID_HANDLE_VALUE != server_ && INVALID_HANDLE_VALUE != client_;
+	}
+
+	/// Send `count` Schedule records packed by `per_frame` in one message.
+	/// \returns Records per second.
+	double run (size_t count, size_t per_frame)
+	{
+		size_t base = records_;
+		auto t0 = std::chrono::steady_clock::now ();
+		SchedulerMessage::Frame frame;
+		for (size_t i = 0; i < count; ++i) {
+			if (frame.size () / sizeof (SchedulerMessage::Schedule) == per_frame
+				|| !frame.append (SchedulerMessage::Schedule (i))) {
+				write (frame);
+				frame.clear ();
+				frame.append (SchedulerMessage::Schedule (i));
+			}
+		}
+		if (!frame.empty ())
+			write (frame);
+		while (records_ - base < count)
+			std::this_thread::yield ();
+		std::chrono::duration <double> dur = std::chrono::steady_clock::now () - t0;
+		return count / dur.count ();
+	}
+
+private:
+	void write (const SchedulerMessage::Frame& frame)
+	{
+		DWORD cb;
+		EXPECT_TRUE (WriteFile (client_, frame.data (), (DWORD)frame.size (), &cb, nullptr));
+	}
+
+	void read_proc ()
+	{
+		uint8_t buf [SchedulerMessage::MAX_FRAME_SIZE];
+		DWORD cb;
+		while (ReadFile (server_, buf, sizeof (buf), &cb, nullptr)) {
+			size_t cnt = 0;
+			SchedulerMessage::parse (buf, cb, [&cnt] (const SchedulerMessage::Header&) { ++cnt; });
+			records_ += cnt;
+		}
+	}
+
+private:
+	HANDLE server_;
+	HANDLE client_;
+	std::thread reader_;
+	std::atomic <size_t> records_;
+};
+
+TEST_F (TestSchedulerMessage, Throughput)
+{
+	static const size_t COUNT = 200000;
+
+	PipeBench bench;
+	ASSERT_TRUE (bench.valid ());
+
+	double single = bench.run (COUNT, 1);
+	std::cout << "One record per message: " << (uint64_t)single << " records/s" << std::endl;
+
+	for (size_t per_frame = 4; per_frame <= 16; per_frame *= 2) {
+		double framed = bench.run (COUNT, per_frame);
+		std::cout << per_frame << " records per frame: " << (uint64_t)framed << " records/s" << std::endl;
+		EXPECT_GT (framed, single);
+	}
+}
+
+}
@@ -0,0 +1,207 @@
+// Shared scheduler ring stress test. Does not depend on Windows API.
+#include "../Source/SchedulerRing.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+namespace TestSchedulerRing {
+
+using ::Nirvana::Core::Windows::SchedulerRing;
+
+struct Record
+{
+	uint32_t producer;
+	uint32_t seq;
+};
+
+typedef SchedulerRing <Record> Ring;
+
+class TestSchedulerRing :
+	public ::testing::Test
+{
+protected:
+	TestSchedulerRing ()
+	{}
+
+	virtual ~TestSchedulerRing ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+	// Emulates shared memory section: zero-initialized and aligned to page.
+	class Section
+	{
+	public:
+		Section (uint32_t capacity) :
+			size_ (Ring::required_size (capacity)),
+			mem_ (new uint64_t [(size_ + sizeof (uint64_t) - 1) / sizeof (uint64_t)] ())
+		{}
+
+		void* data () const
+		{
+			return mem_.get ();
+		}
+
+		size_t size () const
+		{
+			return size_;
+		}
+
+	private:
+		size_t size_;
+		std::unique_ptr <uint64_t []> mem_;
+	};
+};
+
+TEST_F (TestSchedulerRing, Signal)
+{
+	static const uint32_t CAPACITY = 4;
+	Section section (CAPACITY);
+	Ring producer, consumer;
+	ASSERT_TRUE (producer.create (section.data (), section.size (), CAPACITY));
+	ASSERT_TRUE (consumer.attach (section.data (), section.size ()));
+
+	bool signal;
+	ASSERT_TRUE (producer.push (Record{ 0, 0 }, signal));
+	EXPECT_TRUE (signal);
+	ASSERT_TRUE (producer.push (Record{ 0, 1 }, signal));
+	EXPECT_FALSE (signal);
+	ASSERT_TRUE (producer.push (Record{ 0, 2 }, signal));
+	ASSERT_TRUE (producer.push (Record{ 0, 3 }, signal));
+	EXPECT_FALSE (producer.push (Record{ 0, 4 }, signal)); // Full
+
+	uint32_t expected = 0;
+	EXPECT_TRUE (consumer.drain ([&expected] (const Record& r) {
+		EXPECT_EQ (r.seq, expected);
+		++expected;
+	}));
+	EXPECT_EQ (expected, CAPACITY);
+
+	// Empty again, so the next push must signal.
+	ASSERT_TRUE (producer.push (Record{ 0, 5 }, signal));
+	EXPECT_TRUE (signal);
+}
+
+TEST_F (TestSchedulerRing, Attach)
+{
+	Section section (8);
+	Ring ring;
+	EXPECT_FALSE (ring.attach (section.data (), 16));
+	ASSERT_TRUE (ring.create (section.data (), section.size (), 8));
+	Ring other;
+	EXPECT_TRUE (other.attach (section.data (), section.size ()));
+	EXPECT_FALSE (other.attach (section.data (), section.size () - 1));
+}
+
+// The producer process may write any value to the pending counter.
+// The drain must not loop forever.
+TEST_F (TestSchedulerRing, BogusPending)
+{
+	static const uint32_t CAPACITY = 8;
+	static const size_t PENDING_OFFSET = 192; // See SchedulerRing::Control
+	Section section (CAPACITY);
+	Ring ring;
+	ASSERT_TRUE (ring.create (section.data (), section.size (), CAPACITY));
+	std::atomic <int32_t>& pending = *(std::atomic <int32_t>*)((uint8_t*)section.data () + PENDING_OFFSET);
+
+	bool signal;
+	unsigned received = 0;
+	auto f = [&received] (const Record&) { ++received; };
+
+	ASSERT_TRUE (ring.push (Record{ 0, 0 }, signal));
+	pending = 5;
+	EXPECT_FALSE (ring.drain (f));
+	EXPECT_EQ (received, 1u);
+
+	ASSERT_TRUE (ring.push (Record{ 0, 1 }, signal));
+	pending = 1000000;
+	EXPECT_FALSE (ring.drain (f));
+	EXPECT_EQ (received, 2u);
+
+	pending = 3;
+	EXPECT_FALSE (ring.drain (f));
+}
+
+// Many producers, one signalled consumer.
+// Each signal must be followed by the drain, and each record must be received exactly once.
+TEST_F (TestSchedulerRing, Stress)
+{
+	static const uint32_t CAPACITY = 256;
+	static const uint32_t PRODUCERS = 8;
+	static const uint32_t RECORDS = 200000;
+
+	Section section (CAPACITY);
+	Ring consumer;
+	ASSERT_TRUE (consumer.create (section.data (), section.size (), CAPACITY));
+
+	std::atomic <uint32_t> signals (0);
+	std::atomic <bool> finished (false);
+	std::vector <uint32_t> received (PRODUCERS, 0);
+	std::atomic <uint32_t> overflows (0);
+
+	std::thread consumer_thread ([&] () {
+		for (;;) {
+			uint32_t s = signals.load ();
+			if (!s) {
+				if (finished.load () && !signals.load ())
+					break;
+				std::this_thread::yield ();
+				continue;
+			}
+			signals.fetch_sub (1);
+			EXPECT_TRUE (consumer.drain ([&received] (const Record& r) {
+				// Records from one producer come in order.
+				EXPECT_EQ (r.seq, received [r.producer]);
+				++received [r.producer];
+			}));
+		}
+	});
+
+	std::vector <std::thread> producers;
+	for (uint32_t p = 0; p < PRODUCERS; ++p) {
+		producers.emplace_back ([&, p] () {
+			Ring ring;
+			ASSERT_TRUE (ring.attach (section.data (), section.size ()));
+			for (uint32_t i = 0; i < RECORDS; ++i) {
+				bool signal;
+				while (!ring.push (Record{ p, i }, signal)) {
+					overflows.fetch_add (1, std::memory_order_relaxed);
+					std::this_thread::yield ();
+				}
+				if (signal)
+					signals.fetch_add (1);
+			}
+		});
+	}
+
+	for (auto& t : producers) {
+		t.join ();
+	}
+	finished = true;
+	consumer_thread.join ();
+
+	for (uint32_t p = 0; p < PRODUCERS; ++p) {
+		EXPECT_EQ (received [p], RECORDS);
+	}
+
+	bool signal;
+	ASSERT_TRUE (consumer.push (Record{ 0, 0 }, signal));
+	EXPECT_TRUE (signal);
+}
+
+}
@@ -0,0 +1,250 @@
+// Scheduler simulation tests and benchmark. Does not depend on Windows API.
+// Build on the host with -ITest/Host.
+#include "SchedulerSim.h"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <algorithm>
+
+namespace TestSchedulerSim {
+
+using namespace ::SchedulerSim;
+
+class TestSchedulerSim :
+	public ::testing::Test
+{
+protected:
+	TestSchedulerSim ()
+	{}
+
+	virtual ~TestSchedulerSim ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+	// All cores are returned and all reservations are released.
+	static void check_balance (const Config& config, const Result& result)
+	{
+		EXPECT_EQ (result.free_cores, config.cores);
+		EXPECT_EQ (result.reserved, 0);
+	}
+};
+
+TEST_F (TestSchedulerSim, Deterministic)
+{
+	Config config;
+	Workload workload = generate (4, config.cores, 10000, 0.9, 1);
+	Result r1 = Simulator (config, workload).run ();
+	Result r2 = Simulator (config, workload).run ();
+	EXPECT_TRUE (r1 == r2);
+	EXPECT_EQ (r1.executed, workload.size ());
+	EXPECT_EQ (r1.unreserved, 0);
+	check_balance (config, r1);
+}
+
+TEST_F (TestSchedulerSim, Replay)
+{
+	std::istringstream in (
+		"# arrival domain deadline duration\n"
+		"0 0 100000 50000\n"
+		"0 1 200000 50000\n"
+		"1000 0 60000 50000\n"
+		"2000 1 1000 50000\n"
+	);
+	Workload workload;
+	ASSERT_TRUE (load (in, workload));
+	ASSERT_EQ (workload.size (), 4);
+
+	Config config;
+	config.cores = 1;
+	Result result = Simulator (config, workload).run ();
+	EXPECT_EQ (result.executed, 4);
+	// The last job has the earliest deadline but can't preempt and is late in any case.
+	EXPECT_GE (result.missed, 1);
+	check_balance (config, result);
+
+	std::istringstream bad ("0 0 x 1\n");
+	Workload w;
+	EXPECT_FALSE (load (bad, w));
+}
+
+// Small ring overflows and records go over the pipe.
+// The records order must be preserved.
+TEST_F (TestSchedulerSim, RingOverflow)
+{
+	Config config;
+	config.ring_capacity = 4;
+	config.pipe_latency = 200000;
+	Workload workload = generate (2, config.cores, 20000, 1.2, 2);
+	Result result = Simulator (config, workload).run ();
+	EXPECT_GT (result.ring_full, 0);
+	EXPECT_EQ (result.executed, workload.size ());
+	EXPECT_EQ (result.unreserved, 0);
+	check_balance (config, result);
+}
+
+// Domains are terminated while their executors are queued and running.
+TEST_F (TestSchedulerSim, Terminate)
+{
+	for (uint64_t seed = 1; seed <= 20; ++seed) {
+		Config config;
+		config.seed = seed;
+		config.ring_capacity = seed % 2 ? 16 : 0;
+		Workload workload = generate (4, config.cores, 5000, 1.5, seed);
+		Simulator sim (config, workload);
+		Time end = workload.back ().arrival;
+		sim.kill (0, end / 3);
+		sim.kill (1, end / 2 + (Time)seed * 1000);
+		const Result& result = sim.run ();
+		EXPECT_LT (result.executed, workload.size ());
+		check_balance (config, result);
+	}
+}
+
+// Executors submit the new ones from the worker threads, so the item records are deferred and combined.
+// The pipe messages are processed out of order as by the concurrent postman threads.
+TEST_F (TestSchedulerSim, Protocol)
+{
+	for (uint64_t seed = 1; seed <= 10; ++seed) {
+		Config config;
+		config.seed = seed;
+		config.worker_submit = 50;
+		config.postman_reorder = true;
+		config.ring_capacity = seed % 2 ? 16 : 0;
+		Workload workload = generate (4, config.cores, 5000, 1.1, seed);
+		Result result = Simulator (config, workload).run ();
+		EXPECT_EQ (result.executed, workload.size ());
+		check_balance (config, result);
+
+		// FIFO pipe: each item is created before it is scheduled.
+		config.postman_reorder = false;
+		result = Simulator (config, workload).run ();
+		EXPECT_EQ (result.executed, workload.size ());
+		EXPECT_EQ (result.unreserved, 0);
+		check_balance (config, result);
+	}
+}
+
+TEST_F (TestSchedulerSim, BudgetLimit)
+{
+	CoreBudget budget;
+	EXPECT_EQ (budget.limit (8, 0), 0);
+	EXPECT_TRUE (budget.admit (100, 8, 0));
+	budget.set (3, 0);
+	EXPECT_EQ (budget.limit (8, 4), 3);
+	EXPECT_FALSE (budget.admit (3, 8, 4));
+	budget.set (0, 1);
+	EXPECT_EQ (budget.limit (8, 4), 2);
+	EXPECT_EQ (budget.limit (2, 4), 1); // At least one core
+	budget.set (1, 3);
+	EXPECT_EQ (budget.limit (8, 4), 1);
+}
+
+// Domain 0 floods the short deadlines and overloads the system.
+// Domain 1 has rare latency-critical executors.
+TEST_F (TestSchedulerSim, Budget)
+{
+	Workload workload;
+	for (Time t = 0; t < 20000000; t += 10000) {
+		workload.push_back (Job { t, 0, 60000, 50000 });
+	}
+	for (Time t = 5000; t < 20000000; t += 500000) {
+		workload.push_back (Job { t, 1, 300000, 50000 });
+	}
+	std::sort (workload.begin (), workload.end (), [] (const Job& l, const Job& r) {
+		return l.arrival < r.arrival;
+	});
+
+	Config config;
+	Result unlimited = Simulator (config, workload).run ();
+	config.budgets.emplace_back (config.cores - 1, 0);
+	Result limited = Simulator (config, workload).run ();
+
+	std::cout << "Unlimited: domain 1 missed " << unlimited.domain_missed [1] << " of "
+		<< 20000000 / 500000 << ", domain 0 missed " << unlimited.domain_missed [0] << std::endl;
+	std::cout << "Quota " << config.cores - 1 << ":   domain 1 missed " << limited.domain_missed [1]
+		<< ", domain 0 missed " << limited.domain_missed [0]
+		<< ", throttled " << limited.throttled << std::endl;
+
+	EXPECT_EQ (limited.executed, workload.size ());
+	EXPECT_GT (limited.throttled, 0);
+	EXPECT_LT (limited.domain_missed [1], unlimited.domain_missed [1]);
+	check_balance (config, limited);
+
+	// Without contention the domain borrows the idle cores.
+	Workload single;
+	for (const Job& job : workload) {
+		if (!job.domain)
+			single.push_back (job);
+	}
+	Config one;
+	Result free = Simulator (one, single).run ();
+	one.budgets.emplace_back (1, 0);
+	Result borrowed = Simulator (one, single).run ();
+	EXPECT_EQ (borrowed.makespan, free.makespan);
+}
+
+// Both domains overload the system with the same deadlines.
+// The throttled domain may not borrow while the other domain waits, so the cores are shared by the weights.
+TEST_F (TestSchedulerSim, Weights)
+{
+	static const Time PERIOD = 20000000;
+
+	Workload workload;
+	for (Time t = 0; t < PERIOD; t += 10000) {
+		workload.push_back (Job { t, 0, 100000, 50000 });
+		workload.push_back (Job { t, 1, 100000, 50000 });
+	}
+
+	Config config;
+	config.throttle_delay = 200000;
+	config.budgets.emplace_back (0, 1);
+	config.budgets.emplace_back (0, 3);
+	Simulator sim (config, workload);
+	sim.kill (0, PERIOD);
+	sim.kill (1, PERIOD);
+	Result result = sim.run ();
+
+	std::cout << "Weights 1:3: domain 0 executed " << result.domain_executed [0]
+		<< ", domain 1 executed " << result.domain_executed [1]
+		<< ", throttled " << result.throttled << std::endl;
+
+	EXPECT_GT (result.throttled, 0);
+	EXPECT_GT (result.domain_executed [1], result.domain_executed [0] * 2);
+	EXPECT_EQ (result.free_cores, config.cores);
+}
+
+TEST_F (TestSchedulerSim, Benchmark)
+{
+	Config pipe;
+	pipe.ring_capacity = 0;
+	Config ring;
+	for (double load : { 0.5, 0.9, 1.1 }) {
+		Workload workload = generate (8, ring.cores, 50000, load, 3);
+		Result rp = Simulator (pipe, workload).run ();
+		Result rr = Simulator (ring, workload).run ();
+		std::cout << "Load " << load << ":\n"
+			<< "  pipe: " << (uint64_t)rp.throughput () << " jobs/s, missed " << rp.missed
+			<< ", max lateness " << rp.max_lateness << " ns, " << rp.pipe_messages << " pipe messages\n"
+			<< "  ring: " << (uint64_t)rr.throughput () << " jobs/s, missed " << rr.missed
+			<< ", max lateness " << rr.max_lateness << " ns, " << rr.pipe_messages << " pipe messages"
+			<< std::endl;
+		EXPECT_EQ (rp.executed, workload.size ());
+		EXPECT_EQ (rr.executed, workload.size ());
+		EXPECT_LT (rr.pipe_messages, rp.pipe_messages);
+	}
+}
+
+}
@@ -0,0 +1,117 @@
+// Scheduler statistics tests. Does not depend on Windows API.
+#include "../Source/SchedulerStats.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <memory>
+
+namespace TestSchedulerStats {
+
+using ::Nirvana::Core::Windows::SchedulerStats;
+
+class TestSchedulerStats :
+	public ::testing::Test
+{
+protected:
+	TestSchedulerStats ()
+	{}
+
+	virtual ~TestSchedulerStats ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		// Emulate zero-filled shared memory section.
+		mem_.reset (new uint64_t [sizeof (SchedulerStats) / sizeof (uint64_t) + 8] ());
+		stats_ = (SchedulerStats*)(((uintptr_t)mem_.get () + 63) & ~(uintptr_t)63);
+		stats_->create (1000000000);
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+protected:
+	std::unique_ptr <uint64_t []> mem_;
+	SchedulerStats* stats_;
+};
+
+TEST_F (TestSchedulerStats, Buckets)
+{
+	for (uint64_t v = 0; v < 1000; ++v) {
+		unsigned b = SchedulerStats::bucket (v);
+		ASSERT_LE (SchedulerStats::bucket_min (b), v);
+		ASSERT_GT (SchedulerStats::bucket_min (b + 1), v);
+	}
+	for (unsigned e = 3; e < 64; ++e) {
+		uint64_t v = (uint64_t)1 << e;
+		EXPECT_EQ (SchedulerStats::bucket_min (SchedulerStats::bucket (v)), v);
+		EXPECT_EQ (SchedulerStats::bucket_min (SchedulerStats::bucket (v - 1) + 1), v);
+	}
+	EXPECT_EQ (SchedulerStats::bucket (~(uint64_t)0), SchedulerStats::BUCKETS - 1);
+}
+
+TEST_F (TestSchedulerStats, Percentile)
+{
+	EXPECT_TRUE (stats_->valid ());
+	for (uint64_t v = 1; v <= 1000; ++v) {
+		stats_->record ((unsigned)v, SchedulerStats::LATENESS, v * 1000);
+	}
+	std::unique_ptr <SchedulerStats::Snapshot> s (new SchedulerStats::Snapshot);
+	stats_->snapshot (*s);
+	EXPECT_EQ (s->count (SchedulerStats::LATENESS), 1000);
+	EXPECT_EQ (s->count (SchedulerStats::QUEUE_DEPTH), 0);
+	uint64_t p50 = s->percentile (SchedulerStats::LATENESS, 50);
+	uint64_t p99 = s->percentile (SchedulerStats::LATENESS, 99);
+	EXPECT_LE (p50, 500000);
+	EXPECT_GT (p50, 500000 * 7 / 8);
+	EXPECT_LE (p99, 990000);
+	EXPECT_GT (p99, 990000 * 7 / 8);
+	EXPECT_EQ (s->percentile (SchedulerStats::QUEUE_DEPTH, 50), 0);
+}
+
+// Updates from many threads are not lost and snapshots are monotonic.
+TEST_F (TestSchedulerStats, Concurrent)
+{
+	static const unsigned THREADS = 8;
+	static const unsigned ITERATIONS = 100000;
+
+	std::vector <std::thread> threads;
+	for (unsigned t = 0; t < THREADS; ++t) {
+		threads.emplace_back ([this, t] () {
+			for (unsigned i = 0; i < ITERATIONS; ++i) {
+				stats_->add (t, SchedulerStats::SCHEDULE);
+				stats_->enqueued (t);
+				stats_->add (t, SchedulerStats::DISPATCH);
+				stats_->dequeued (t);
+			}
+		});
+	}
+
+	std::unique_ptr <SchedulerStats::Snapshot> s (new SchedulerStats::Snapshot);
+	uint64_t prev = 0;
+	for (int i = 0; i < 100; ++i) {
+		stats_->snapshot (*s);
+		EXPECT_GE (s->counters [SchedulerStats::SCHEDULE], prev);
+		prev = s->counters [SchedulerStats::SCHEDULE];
+	}
+
+	for (auto& t : threads) {
+		t.join ();
+	}
+	stats_->snapshot (*s);
+	EXPECT_EQ (s->counters [SchedulerStats::SCHEDULE], THREADS * ITERATIONS);
+	EXPECT_EQ (s->counters [SchedulerStats::DISPATCH], THREADS * ITERATIONS);
+	EXPECT_EQ (s->count (SchedulerStats::QUEUE_DEPTH), THREADS * ITERATIONS);
+	EXPECT_EQ (s->queue_depth, 0);
+	EXPECT_LE (s->percentile (SchedulerStats::QUEUE_DEPTH, 100), THREADS);
+}
+
+}
@@ -0,0 +1,111 @@
+// Memory section pool tests and section creation benchmark.
+#include "../Source/SectionPool.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace TestSectionPool {
+
+using namespace ::Nirvana::Core::Windows;
+
+class TestSectionPool :
+	public ::testing::Test
+{
+protected:
+	TestSectionPool ()
+	{}
+
+	virtual ~TestSectionPool ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		ASSERT_TRUE (pool_.initialize ());
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+	static void close (std::vector <HANDLE>& sections)
+	{
+		for (HANDLE h : sections) {
+			CloseHandle (h);
+		}
+		sections.clear ();
+	}
+
+protected:
+	SectionPool pool_;
+};
+
+TEST_F (TestSectionPool, Get)
+{
+	// Let the background thread fill the initial stock.
+	Sleep (SECTION_POOL_PERIOD);
+
+	std::vector <HANDLE> sections;
+	for (unsigned i = 0; i < SECTION_POOL_MIN; ++i) {
+		HANDLE h = pool_.get ();
+		ASSERT_TRUE (h);
+		sections.push_back (h);
+	}
+
+	// The section must be mappable.
+	void* p = MapViewOfFile (sections.front (), FILE_MAP_WRITE, 0, 0, ALLOCATION_GRANULARITY);
+	ASSERT_TRUE (p);
+	EXPECT_TRUE (VirtualAlloc (p, PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE));
+	*(int*)p = 1;
+	UnmapViewOfFile (p);
+
+	close (sections);
+}
+
+// The stock grows with the allocation rate.
+TEST_F (TestSectionPool, Adapt)
+{
+	static const unsigned COUNT = 64;
+	static const unsigned ROUNDS = 5;
+
+	std::vector <HANDLE> sections;
+	unsigned hits = 0, total = 0;
+	std::chrono::duration <double, std::micro> pooled (0), created (0);
+	for (unsigned round = 0; round < ROUNDS; ++round) {
+		for (unsigned i = 0; i < COUNT; ++i) {
+			auto t0 = std::chrono::steady_clock::now ();
+			HANDLE h = pool_.get ();
+			if (h) {
+				pooled += std::chrono::steady_clock::now () - t0;
+				++hits;
+			} else {
+				h = SectionPool::create ();
+				created += std::chrono::steady_clock::now () - t0;
+			}
+			ASSERT_TRUE (h);
+			sections.push_back (h);
+			++total;
+		}
+		close (sections);
+		Sleep (SECTION_POOL_PERIOD * 2);
+	}
+
+	std::cout << "Pool hits: " << hits << " of " << total;
+	if (hits)
+		std::cout << ", pooled " << pooled.count () / hits << " us";
+	if (total > hits)
+		std::cout << ", created " << created.count () / (total - hits) << " us";
+	std::cout << std::endl;
+
+	// After the first round the stock must cover the most of the demand.
+	EXPECT_GT (hits, total / 2);
+}
+
+}
@@ -0,0 +1,154 @@
+// Thread placement tests with synthetic topologies. Does not depend on Windows API.
+#include "../Source/Topology.h"
+#include <gtest/gtest.h>
+#include <set>
+#include <memory>
+
+namespace TestTopology {
+
+using namespace ::Nirvana::Core::Windows;
+
+class TestTopology :
+	public ::testing::Test
+{
+protected:
+	TestTopology ()
+	{}
+
+	virtual ~TestTopology ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		model_.reset (new TopologyModel);
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+	/// Build the synthetic topology.
+	/// Each NUMA node is a separate processor group with `cores` physical cores of `smt` siblings.
+	/// Node numbers are not contiguous, like on the real systems.
+	void build (unsigned nodes, unsigned cores, unsigned smt)
+	{
+		uint32_t core = 0;
+		for (unsigned node = 0; node < nodes; ++node) {
+			unsigned number = 0;
+			for (unsigned c = 0; c < cores; ++c, ++core) {
+				for (unsigned s = 0; s < smt; ++s) {
+					ASSERT_TRUE (model_->add ((uint16_t)node, (uint8_t)number++, node * 2, core));
+				}
+			}
+		}
+	}
+
+protected:
+	std::unique_ptr <TopologyModel> model_;
+};
+
+TEST_F (TestTopology, Model)
+{
+	build (2, 4, 2);
+	EXPECT_EQ (model_->processor_count (), 16);
+	EXPECT_EQ (model_->node_count (), 2);
+	EXPECT_EQ (model_->node_number (1), 2);
+	EXPECT_EQ (model_->processor (15).node, 1);
+	EXPECT_EQ (model_->processor (15).group, 1);
+	EXPECT_EQ (model_->processor (15).number, 7);
+}
+
+// Threads go round-robin over the nodes and use all physical cores before SMT siblings.
+TEST_F (TestTopology, Spread)
+{
+	build (2, 4, 2);
+	std::unique_ptr <Placement> placement (new Placement (*model_));
+
+	std::set <uint32_t> cores;
+	for (unsigned t = 0; t < 8; ++t) {
+		EXPECT_EQ (placement->node (t), t % 2);
+		EXPECT_TRUE (cores.insert (model_->processor (placement->processor (t)).core).second);
+	}
+
+	std::set <unsigned> processors;
+	for (unsigned t = 0; t < 16; ++t) {
+		EXPECT_TRUE (processors.insert (placement->processor (t)).second);
+	}
+	EXPECT_EQ (placement->processor (16), placement->processor (0));
+}
+
+// More than 64 logical processors in several groups.
+TEST_F (TestTopology, Groups)
+{
+	build (4, 32, 2);
+	ASSERT_EQ (model_->processor_count (), 256);
+	std::unique_ptr <Placement> placement (new Placement (*model_));
+
+	std::set <uint16_t> groups;
+	for (unsigned t = 0; t < 4; ++t) {
+		groups.insert (model_->processor (placement->processor (t)).group);
+	}
+	EXPECT_EQ (groups.size (), 4);
+}
+
+// Nodes of different size.
+TEST_F (TestTopology, Unbalanced)
+{
+	ASSERT_TRUE (model_->add (0, 0, 0, 0));
+	ASSERT_TRUE (model_->add (0, 1, 1, 1));
+	ASSERT_TRUE (model_->add (0, 2, 1, 2));
+	ASSERT_TRUE (model_->add (0, 3, 1, 3));
+	Placement placement (*model_);
+	EXPECT_EQ (placement.node (0), 0);
+	EXPECT_EQ (placement.node (1), 1);
+	EXPECT_EQ (placement.node (2), 1);
+	EXPECT_EQ (placement.node (3), 1);
+}
+
+// Reserved cores with their SMT siblings are excluded from the worker placement.
+TEST_F (TestTopology, Reserve)
+{
+	build (2, 4, 2);
+	std::unique_ptr <Placement> placement (new Placement (*model_, 2));
+	EXPECT_EQ (placement->count (), 12);
+	ASSERT_EQ (placement->reserved_count (), 4);
+
+	std::set <uint32_t> reserved_cores;
+	std::set <unsigned> reserved;
+	for (unsigned t = 0; t < placement->reserved_count (); ++t) {
+		unsigned p = placement->reception (t);
+		reserved.insert (p);
+		reserved_cores.insert (model_->processor (p).core);
+	}
+	EXPECT_EQ (reserved.size (), 4);
+	EXPECT_EQ (reserved_cores.size (), 2);
+
+	// The first reception threads use different physical cores.
+	EXPECT_NE (model_->processor (placement->reception (0)).core, model_->processor (placement->reception (1)).core);
+
+	for (unsigned t = 0; t < placement->count (); ++t) {
+		EXPECT_EQ (reserved_cores.count (model_->processor (placement->processor (t)).core), 0);
+	}
+
+	// Workers are still spread over both nodes.
+	EXPECT_NE (placement->node (0), placement->node (1));
+}
+
+// The reservation is ignored if no cores remain for the workers.
+TEST_F (TestTopology, ReserveAll)
+{
+	build (1, 2, 2);
+	Placement placement (*model_, 2);
+	EXPECT_EQ (placement.count (), 4);
+	EXPECT_EQ (placement.reserved_count (), 0);
+	EXPECT_EQ (placement.reception (1), placement.processor (1));
+}
+
+}
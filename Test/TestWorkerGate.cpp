@@ -0,0 +1,207 @@
+// Worker gate tests and wake latency benchmark. Does not depend on Windows API.
+#include "../Source/WorkerGate.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+namespace TestWorkerGate {
+
+using ::Nirvana::Core::Windows::WorkerGate;
+
+class TestWorkerGate :
+	public ::testing::Test
+{
+protected:
+	TestWorkerGate () :
+		stop_ (false)
+	{}
+
+	virtual ~TestWorkerGate ()
+	{}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+	virtual void SetUp ()
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+		gate_.create (&shared_);
+	}
+
+	virtual void TearDown ()
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+protected:
+	// Emulates the kernel semaphore.
+	class Semaphore
+	{
+	public:
+		Semaphore () :
+			count_ (0)
+		{}
+
+		void release ()
+		{
+			std::lock_guard <std::mutex> lock (mutex_);
+			++count_;
+			cv_.notify_one ();
+		}
+
+		void wait ()
+		{
+			std::unique_lock <std::mutex> lock (mutex_);
+			cv_.wait (lock, [this] () { return count_ > 0; });
+			--count_;
+		}
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		unsigned count_;
+	};
+
+	// Master side: grant one core.
+	void grant ()
+	{
+		if (gate_.release ())
+			semaphore_.release ();
+	}
+
+	// Worker side: wait for a grant.
+	void wait (WorkerGate::SpinPolicy& policy)
+	{
+		WorkerGate::Clock::time_point idle = WorkerGate::Clock::now ();
+		if (!gate_.acquire (policy, stop_))
+			semaphore_.wait ();
+		policy.woken (std::chrono::duration_cast <std::chrono::nanoseconds> (
+			WorkerGate::Clock::now () - idle).count ());
+	}
+
+	// Wake latency for the grants sent each `interval`.
+	std::vector <uint64_t> wake_latency (uint32_t spin_max, std::chrono::microseconds interval, unsigned count)
+	{
+		std::atomic <int64_t> released (0);
+		std::atomic <unsigned> done (0);
+		std::vector <uint64_t> latency;
+		latency.reserve (count);
+
+		std::thread worker ([&] () {
+			WorkerGate::SpinPolicy policy (spin_max);
+			for (unsigned i = 0; i < count; ++i) {
+				wait (policy);
+				auto now = WorkerGate::Clock::now ().time_since_epoch ();
+				latency.push_back (std::chrono::duration_cast <std::chrono::nanoseconds> (now).count ()
+					- released.load (std::memory_order_acquire));
+				done.fetch_add (1, std::memory_order_release);
+			}
+		});
+
+		for (unsigned i = 0; i < count; ++i) {
+			// Moderate load: the worker is idle between the grants.
+			auto next = WorkerGate::Clock::now () + interval;
+			while (WorkerGate::Clock::now () < next)
+				std::this_thread::yield ();
+			released.store (std::chrono::duration_cast <std::chrono::nanoseconds> (
+				WorkerGate::Clock::now ().time_since_epoch ()).count (), std::memory_order_release);
+			grant ();
+			while (done.load (std::memory_order_acquire) <= i)
+				std::this_thread::yield ();
+		}
+		worker.join ();
+		std::sort (latency.begin (), latency.end ());
+		return latency;
+	}
+
+	static uint64_t percentile (const std::vector <uint64_t>& sorted, unsigned p)
+	{
+		return sorted [(sorted.size () - 1) * p / 100];
+	}
+
+protected:
+	WorkerGate::Shared shared_;
+	WorkerGate gate_;
+	Semaphore semaphore_;
+	std::atomic <bool> stop_;
+};
+
+TEST_F (TestWorkerGate, Policy)
+{
+	WorkerGate::SpinPolicy off (0);
+	EXPECT_EQ (off.budget (), 0);
+
+	WorkerGate::SpinPolicy policy (50000);
+	for (int i = 0; i < 32; ++i) {
+		policy.woken (1000);
+	}
+	EXPECT_GE (policy.budget (), 1000);
+	EXPECT_LE (policy.budget (), 4000);
+
+	// Long idle periods disable spinning
+	for (int i = 0; i < 32; ++i) {
+		policy.woken (10000000);
+	}
+	EXPECT_EQ (policy.budget (), 0);
+
+	// And short ones enable it again
+	for (int i = 0; i < 64; ++i) {
+		policy.woken (1000);
+	}
+	EXPECT_GT (policy.budget (), 0);
+}
+
+// Each grant must be consumed exactly once.
+TEST_F (TestWorkerGate, Grants)
+{
+	static const unsigned WORKERS = 4;
+	static const unsigned GRANTS = 100000;
+
+	std::atomic <unsigned> consumed (0);
+	std::vector <std::thread> workers;
+	for (unsigned w = 0; w < WORKERS; ++w) {
+		workers.emplace_back ([&, w] () {
+			WorkerGate::SpinPolicy policy (w % 2 ? 50000 : 0);
+			for (;;) {
+				wait (policy);
+				if (consumed.fetch_add (1) >= GRANTS)
+					break;
+			}
+		});
+	}
+	for (unsigned i = 0; i < GRANTS + WORKERS; ++i) {
+		grant ();
+	}
+	for (auto& t : workers) {
+		t.join ();
+	}
+	EXPECT_EQ (consumed.load (), GRANTS + WORKERS);
+	EXPECT_EQ (shared_.count.load (), 0);
+}
+
+TEST_F (TestWorkerGate, WakeLatency)
+{
+	static const unsigned COUNT = 5000;
+	static const std::chrono::microseconds INTERVAL (20);
+
+	std::vector <uint64_t> park = wake_latency (0, INTERVAL, COUNT);
+	std::vector <uint64_t> spin = wake_latency (50000, INTERVAL, COUNT);
+
+	std::cout << "Park immediately: p50 " << percentile (park, 50) << " ns, p99 "
+		<< percentile (park, 99) << " ns" << std::endl;
+	std::cout << "Spin then park:   p50 " << percentile (spin, 50) << " ns, p99 "
+		<< percentile (spin, 99) << " ns" << std::endl;
+
+	// Spinning is useless on the single processor.
+	if (std::thread::hardware_concurrency () > 1) {
+		EXPECT_LT (percentile (spin, 50), percentile (park, 50));
+	}
+}
+
+}